@@ -0,0 +1,25 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include "ast/lexer.hpp"
+#include "workload.hpp"
+
+static void BM_tokenize(benchmark::State& state) {
+    auto program = generate_program(static_cast<int>(state.range(0)));
+    for (auto _: state) {
+        auto tokens = Lexer::tokenize(program);
+        benchmark::DoNotOptimize(tokens.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * program.size()));
+}
+BENCHMARK(BM_tokenize)->Arg(100)->Arg(10000);
+
+static void BM_tokenize_re2(benchmark::State& state) {
+    auto program = generate_program(static_cast<int>(state.range(0)));
+    for (auto _: state) {
+        auto tokens = Lexer::tokenize_re2(program);
+        benchmark::DoNotOptimize(tokens.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * program.size()));
+}
+BENCHMARK(BM_tokenize_re2)->Arg(100)->Arg(10000);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <sys/resource.h>
+
+#include "ast/lexer.hpp"
+#include "ast/parallel_parser.hpp"
+#include "ast/parser.hpp"
+#include "workload.hpp"
+
+static std::unordered_map<Symbol, int> bench_precedence() {
+    return {{Symbol("="), 2}, {Symbol("<"), 10}, {Symbol("+"), 20}, {Symbol("-"), 20}, {Symbol("*"), 40}};
+}
+
+// peak resident set of the whole process, run a benchmark alone to attribute it
+static double peak_rss_mb() {
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_maxrss) / 1024;
+}
+
+static void BM_parse(benchmark::State& state) {
+    auto program = generate_program(static_cast<int>(state.range(0)));
+    auto prec = bench_precedence();
+    for (auto _: state) {
+        auto asts = Parser(Lexer(program), prec).parse();
+        benchmark::DoNotOptimize(asts.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * program.size()));
+    state.counters["peak_rss_mb"] = peak_rss_mb();
+}
+BENCHMARK(BM_parse)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+// range(1) is the number of parsing threads
+static void BM_parse_parallel(benchmark::State& state) {
+    auto program = generate_program(static_cast<int>(state.range(0)));
+    auto prec = bench_precedence();
+    for (auto _: state) {
+        auto asts = ParallelParser(program, prec, static_cast<unsigned>(state.range(1))).parse();
+        benchmark::DoNotOptimize(asts.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * program.size()));
+}
+BENCHMARK(BM_parse_parallel)->Args({10000, 1})->Args({10000, 2})->Args({10000, 4})->Args({10000, 8})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <fstream>
+#include <llvm/Support/raw_ostream.h>
+#include <optional>
+#include <unistd.h>
+#include "ast/lexer.hpp"
+#include "ast/parser.hpp"
+#include "ast/semantic.hpp"
+#include "codegen/codegen.hpp"
+#include "codegen/jit_codegen.hpp"
+#include "workload.hpp"
+
+// type checking alone, on a fresh parse every round
+static void BM_check(benchmark::State& state) {
+    auto program = generate_expressions(static_cast<int>(state.range(0)));
+    TypeManager type_manager;
+    std::unordered_map<Symbol, int> prec = {
+        {Symbols::assign, 2}, {Symbol("<"), 10}, {Symbol("+"), 20}, {Symbol("-"), 20}, {Symbol("*"), 40}};
+    for (auto _: state) {
+        state.PauseTiming();
+        auto asts = Parser(Lexer(program), prec).parse();
+        TypeChecker checker(type_manager);
+        state.ResumeTiming();
+
+        for (auto& ast: asts) {
+            if (!checker.check(*ast)) {
+                state.SkipWithError(checker.err_.c_str());
+                break;
+            }
+        }
+    }
+}
+BENCHMARK(BM_check)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+// type checking alone of programs with many locals, time per function should stay flat as they grow
+static void BM_check_declarations(benchmark::State& state) {
+    auto program = generate_declarations(static_cast<int>(state.range(0)));
+    TypeManager type_manager;
+    std::unordered_map<Symbol, int> prec = {
+        {Symbols::assign, 2}, {Symbol("<"), 10}, {Symbol("+"), 20}, {Symbol("-"), 20}, {Symbol("*"), 40}};
+    for (auto _: state) {
+        state.PauseTiming();
+        auto asts = Parser(Lexer(program), prec).parse();
+        TypeChecker checker(type_manager);
+        state.ResumeTiming();
+
+        for (auto& ast: asts) {
+            if (!checker.check(*ast)) {
+                state.SkipWithError(checker.err_.c_str());
+                break;
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_check_declarations)->Arg(1000)->Arg(8000)->Unit(benchmark::kMillisecond);
+
+// type checking and IR generation of an expression heavy program, parsing is not timed
+static void BM_check_codegen(benchmark::State& state) {
+    auto program = generate_expressions(static_cast<int>(state.range(0)));
+    CodeGeneratorSetting setting = {
+        .print_ir = false,
+    };
+    // the generator of the previous round is torn down while the timer is paused
+    std::optional<CodeGenerator> generator;
+    for (auto _: state) {
+        state.PauseTiming();
+        generator.emplace(llvm::nulls(), setting);
+        auto asts = Parser(Lexer(program), generator->binary_oper_precedence_).parse();
+        TypeChecker checker(generator->type_manager_);
+        state.ResumeTiming();
+
+        for (auto& ast: asts) {
+            if (!checker.check(*ast)) {
+                state.SkipWithError(checker.err_.c_str());
+                break;
+            }
+        }
+        generator->codegen(std::move(asts));
+    }
+}
+BENCHMARK(BM_check_codegen)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+// from handing a prelude of definitions to the jit until the first exec, which calls one of them, has
+// answered; lazily only that one function is compiled
+static void BM_jit_first_exec(benchmark::State& state) {
+    auto program = generate_expressions(static_cast<int>(state.range(0))) + "exec e0(2, 3)\n";
+    CodeGeneratorSetting setting = {
+        .print_ir = false,
+        .lazy_compile = state.range(1) != 0,
+    };
+    std::optional<JitCodeGenerator> generator;
+    for (auto _: state) {
+        state.PauseTiming();
+        generator.reset();
+        generator.emplace(llvm::nulls(), setting);
+        auto asts = Parser(Lexer(program), generator->binary_oper_precedence_).parse();
+        TypeChecker checker(generator->type_manager_);
+        for (auto& ast: asts) {
+            if (!checker.check(*ast)) {
+                state.SkipWithError(checker.err_.c_str());
+                break;
+            }
+        }
+        state.ResumeTiming();
+
+        generator->codegen(std::move(asts));
+    }
+}
+BENCHMARK(BM_jit_first_exec)->ArgNames({"functions", "lazy"})->Args({500, 0})->Args({500, 1})
+    ->Unit(benchmark::kMillisecond);
+
+// resident set of this process, 0 where /proc is missing
+static size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// back to back execs in one long session; one module each, or batched into modules of many thunks,
+// with an exec cache which holds the 100 distinct execs or none
+static void BM_jit_exec(benchmark::State& state) {
+    std::string program;
+    for (int i = 0; i < state.range(0); i++) {
+        program += "exec sq(" + std::to_string(i % 100) + ")\n";
+    }
+    JitCodeGenerator generator(llvm::nulls(), CodeGeneratorSetting {
+        .print_ir = false,
+        .batch_execs = state.range(1) != 0,
+        .exec_cache_size = static_cast<unsigned>(state.range(2)),
+        .exec_mode = ExecMode::Jit,
+    });
+    TypeChecker checker(generator.type_manager_);
+    auto prelude = Parser(Lexer("def sq(x: i32) -> i32 {return x * x;}"), generator.binary_oper_precedence_).parse();
+    checker.check(*prelude.front());
+    generator.codegen(std::move(prelude));
+
+    size_t resident = resident_bytes();
+    for (auto _: state) {
+        state.PauseTiming();
+        auto asts = Parser(Lexer(program), generator.binary_oper_precedence_).parse();
+        for (auto& ast: asts) {
+            if (!checker.check(*ast)) {
+                state.SkipWithError(checker.err_.c_str());
+                break;
+            }
+        }
+        state.ResumeTiming();
+
+        generator.codegen(std::move(asts));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["rss_growth_kb"] = static_cast<double>(resident_bytes() - resident) / 1024;
+}
+BENCHMARK(BM_jit_exec)->ArgNames({"execs", "batch", "cache"})
+    ->Args({10000, 0, 0})->Args({10000, 1, 0})->Args({10000, 0, 128})->Args({10000, 1, 128})
+    ->Unit(benchmark::kMillisecond);
+
+// latency of one small exec, as a repl sends it, compiled or interpreted; every exec differs so nothing
+// is cached, the definitions it calls are compiled once before
+static void BM_exec_latency(benchmark::State& state) {
+    JitCodeGenerator generator(llvm::nulls(), CodeGeneratorSetting {
+        .print_ir = false,
+        .exec_mode = state.range(0) != 0 ? ExecMode::Interpret : ExecMode::Jit,
+    });
+    TypeChecker checker(generator.type_manager_);
+    auto prelude = Parser(Lexer("def sq(x: i32) -> i32 {return x * x;}\nexec sq(1)\n"),
+                          generator.binary_oper_precedence_).parse();
+    for (auto& ast: prelude) {
+        checker.check(*ast);
+    }
+    generator.codegen(std::move(prelude));
+
+    int i = 0;
+    for (auto _: state) {
+        state.PauseTiming();
+        i++;
+        auto source = i % 2 ? "exec: double " + std::to_string(i) + " + 3\n" : "exec sq(" + std::to_string(i) + ")\n";
+        auto asts = Parser(Lexer(source), generator.binary_oper_precedence_).parse();
+        if (!checker.check(*asts.front())) {
+            state.SkipWithError(checker.err_.c_str());
+            break;
+        }
+        state.ResumeTiming();
+
+        generator.codegen(std::move(asts));
+    }
+}
+BENCHMARK(BM_exec_latency)->ArgName("interpret")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
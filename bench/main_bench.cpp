@@ -0,0 +1,16 @@
+#include <benchmark/benchmark.h>
+#include "ast/lexer_bench.hpp"
+#include "ast/parser_bench.hpp"
+#include "codegen/codegen_bench.hpp"
+#include <llvm-c/Target.h>
+
+int main(int argc, char** argv) {
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+    LLVMInitializeNativeAsmParser();
+
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    ::benchmark::Shutdown();
+    return 0;
+}
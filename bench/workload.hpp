@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+
+// a generated program shaped like our machine generated sources,
+// every function calls the previous one so the whole file stays valid.
+inline std::string generate_program(int functions) {
+    std::string program;
+    for (int i = 0; i < functions; i++) {
+        auto name = "f" + std::to_string(i);
+        program += "def " + name + "(x: double, y: double) -> double { # generated function\n";
+        program += "    var a: double = x * 2.5;\n";
+        program += "    for (j = 0: double, j < y) { a = a + j * x - 1; }\n";
+        if (i == 0) {
+            program += "    return a;\n}\n";
+        } else {
+            program += "    return a + f" + std::to_string(i - 1) + "(x, y);\n}\n";
+        }
+    }
+    return program;
+}
+
+// a generated program made of long arithmetic expressions, it stresses the per-node
+// work of checking and code generation rather than the lexer.
+inline std::string generate_expressions(int functions, int terms = 32) {
+    std::string program;
+    for (int i = 0; i < functions; i++) {
+        program += "def e" + std::to_string(i) + "(x: double, y: double) -> double {\n    return x";
+        for (int t = 0; t < terms; t++) {
+            program += t % 3 == 0 ? " + (x - y) * " + std::to_string(t) : t % 3 == 1 ? " - y * x" : " + x * (y + 1)";
+        }
+        if (i > 0) {
+            program += " + e" + std::to_string(i - 1) + "(x, y)";
+        }
+        program += ";\n}\n";
+    }
+    return program;
+}
+
+// a generated program of functions with many local variables, each one read back by the
+// next statement, it stresses symbol lookups and call signatures in the checker.
+inline std::string generate_declarations(int functions, int variables = 64) {
+    std::string program;
+    for (int i = 0; i < functions; i++) {
+        program += "def d" + std::to_string(i) + "(x: double, y: double) -> double {\n";
+        program += "    var v0: double = x;\n    var v1: double = y;\n";
+        for (int v = 2; v < variables; v++) {
+            auto name = "v" + std::to_string(v);
+            program += "    var " + name + ": double = x;\n";
+            program += "    " + name + " = v" + std::to_string(v - 1) + " + v" + std::to_string(v - 2) + " * 2;\n";
+        }
+        program += "    return v" + std::to_string(variables - 1);
+        if (i > 0) {
+            program += " + d" + std::to_string(i - 1) + "(x, y)";
+        }
+        program += ";\n}\n";
+    }
+    return program;
+}
@@ -0,0 +1,26 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+// blocks double from 4 KiB up to this size, a small REPL line stays small
+constexpr size_t max_block_size = 1024 * 1024;
+
+}  // namespace
+
+void* Arena::allocate_slow(size_t size, size_t align) {
+    size_t block_size = std::max(next_block_size_, size + align);
+    next_block_size_ = std::min(next_block_size_ * 2, max_block_size);
+
+    auto& block = blocks_.emplace_back(new std::byte[block_size]);
+    cursor_ = block.get();
+    end_ = block.get() + block_size;
+
+    auto address = reinterpret_cast<uintptr_t>(cursor_);
+    auto aligned = (address + align - 1) & ~(uintptr_t(align) - 1);
+    cursor_ = reinterpret_cast<std::byte*>(aligned + size);
+    bytes_allocated_ += size;
+    return reinterpret_cast<void*>(aligned);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Arena owns the nodes of one parse. Allocation bumps a pointer through large
+/// blocks and nothing is destroyed one by one: all blocks are released together
+/// with the arena, so only trivially destructible types may be placed in it.
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template<typename T, typename Iter>
+    std::span<T> copy(Iter first, Iter last) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        auto n = static_cast<size_t>(std::distance(first, last));
+        if (n == 0) {
+            return {};
+        }
+        auto data = static_cast<T*>(allocate(sizeof(T) * n, alignof(T)));
+        std::uninitialized_copy(first, last, data);
+        return {data, n};
+    }
+
+    template<typename T>
+    std::span<T> copy(const std::vector<T>& values) {
+        return copy<T>(values.begin(), values.end());
+    }
+
+    [[nodiscard]] size_t bytes_allocated() const { return bytes_allocated_; }
+private:
+    void* allocate(size_t size, size_t align) {
+        auto address = reinterpret_cast<uintptr_t>(cursor_);
+        auto aligned = (address + align - 1) & ~(uintptr_t(align) - 1);
+        if (cursor_ && aligned + size <= reinterpret_cast<uintptr_t>(end_)) {
+            cursor_ = reinterpret_cast<std::byte*>(aligned + size);
+            bytes_allocated_ += size;
+            return reinterpret_cast<void*>(aligned);
+        }
+        return allocate_slow(size, align);
+    }
+    void* allocate_slow(size_t size, size_t align);
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    std::byte* cursor_ = nullptr;
+    std::byte* end_ = nullptr;
+    size_t next_block_size_ = 4 * 1024;
+    size_t bytes_allocated_ = 0;
+};
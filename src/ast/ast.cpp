@@ -3,7 +3,6 @@
 #include <vector>
 
 std::ostream& operator<<(std::ostream& os, const Body& body);
-std::ostream& operator<<(std::ostream& os, const ExpressionPtr& e);
 
 std::ostream& operator<<(std::ostream& os, ASTNode& t) {
     t.match(
@@ -51,13 +50,8 @@ std::ostream& operator<<(std::ostream& os, const ProtoType& t) {
 
 std::ostream& operator<<(std::ostream& os, const Body& body) {
     os << "\t[Body]: " << '\n';
-    for (const auto& line: body.data) {
-        os << line;
+    for (auto line: body.data) {
+        os << "\t\t" << line->expression_name() << '\n';
     }
     return os;
-}
-
-std::ostream& operator<<(std::ostream& os, const ExpressionPtr& e) {
-    os << "\t\t" << e->expression_name() << '\n';
-    return os;
 }
\ No newline at end of file
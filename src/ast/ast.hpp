@@ -1,162 +1,255 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 #include <memory>
 #include <ostream>
+#include <span>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <variant>
 
 #include "utils/rustic_match.hpp"
+#include "arena.hpp"
+#include "symbol.hpp"
 #include "type.hpp"
+#include "type_id.hpp"
+
+// the concrete type of an Expression, every node struct names its own in `tag`
+enum class ExprKind: uint8_t {
+    Array,
+    Literal,
+    Variable,
+    Binary,
+    Call,
+    If,
+    For,
+    Unary,
+    VarDeclare,
+    Return,
+};
 
+// Every node below lives in the Arena of the parse which created it. Nodes refer to
+// their children with plain pointers and spans, and are never destroyed one by one.
+// Expression has no vtable, dispatch goes through `kind`, see visit_expression().
 class Expression {
 public:
-    virtual ~Expression() = default;
-    virtual std::string& expression_name() = 0;
+    const ExprKind kind;
+    std::string& expression_name();
+protected:
+    explicit Expression(ExprKind k): kind(k) {}
+    ~Expression() = default;
 };
 
-using ExpressionPtr = std::unique_ptr<Expression>;
+using ExpressionPtr = Expression*;
 
 struct ArrayExpr: public Expression {
-    std::vector<ExpressionPtr> elements;
-    std::string type;
-    ArrayExpr(std::vector<ExpressionPtr> _elements, std::string _type): elements(std::move(_elements)), type(std::move(_type)) {}
-    std::string& expression_name() override {static std::string name = "[Array]"; return name;}
+    static constexpr ExprKind tag = ExprKind::Array;
+    std::span<ExpressionPtr> elements;
+    Symbol type;
+    TypeId type_id = TypeSystem::BuiltinTypes::uninit; // resolved by the TypeChecker
+    ArrayExpr(std::span<ExpressionPtr> _elements, Symbol _type): Expression(tag), elements(_elements), type(_type) {}
+    std::string& expression_name() {static std::string name = "[Array]"; return name;}
 };
 
 struct Body {
-    std::vector<ExpressionPtr> data;
-    bool has_return_value;
-    Body(std::vector<ExpressionPtr> body, bool _has_return_value): 
-        data(std::move(body)), has_return_value(_has_return_value) {}
+    std::span<ExpressionPtr> data;
+    bool has_return_value = false;
+    Body(std::span<ExpressionPtr> body, bool _has_return_value): 
+        data(body), has_return_value(_has_return_value) {}
     Body() = default;
 };
 
 struct LiteralExpr: public Expression {
+    static constexpr ExprKind tag = ExprKind::Literal;
     double value;
-    std::string type;
+    Symbol type;
+    TypeId type_id = TypeSystem::BuiltinTypes::uninit; // resolved by the TypeChecker
 
-    explicit LiteralExpr(double d, std::string _type): value(d), type(std::move(_type)) {}
+    explicit LiteralExpr(double d, Symbol _type): Expression(tag), value(d), type(_type) {}
 
-    std::string& expression_name() override {static std::string name = "[Literal]"; return name;}
+    std::string& expression_name() {static std::string name = "[Literal]"; return name;}
 };
 
 struct VariableExpr: public Expression {
-    std::string name;
-
-    using Addr = std::variant<std::string, ExpressionPtr>;
-    std::vector<Addr> addrs;    
-    explicit VariableExpr(std::string str): name(std::move(str)) {}
+    static constexpr ExprKind tag = ExprKind::Variable;
+    Symbol name;
+
+    // a struct member, the TypeChecker fills in its position
+    struct Field {
+        Symbol name;
+        unsigned int index = 0;
+    };
+    using Addr = std::variant<Field, ExpressionPtr>;
+    std::span<Addr> addrs;    
+    explicit VariableExpr(Symbol str): Expression(tag), name(str) {}
 
     VariableExpr(
-        std::string str, 
-        std::vector<Addr> addresses, 
+        Symbol str, 
+        std::span<Addr> addresses, 
         bool _is_array_offset):
-        name(std::move(str)), addrs(std::move(addresses)), is_array_offset(_is_array_offset) {}
+        Expression(tag), name(str), addrs(addresses), is_array_offset(_is_array_offset) {}
 
-    std::string& expression_name() override {static std::string name = "[Variable]"; return name;}
+    std::string& expression_name() {static std::string name = "[Variable]"; return name;}
     bool is_array_offset = true;
 };
 
 struct BinaryExpr: public Expression {
-    std::string oper;
-    std::unique_ptr<Expression> lhs;
-    std::unique_ptr<Expression> rhs;
-    BinaryExpr(
-        std::string op,
-        std::unique_ptr<Expression> LHS,
-        std::unique_ptr<Expression> RHS
-    ): oper(std::move(op)), lhs(std::move(LHS)), rhs(std::move(RHS)) {}
+    static constexpr ExprKind tag = ExprKind::Binary;
+    Symbol oper;
+    ExpressionPtr lhs;
+    ExpressionPtr rhs;
+    BinaryExpr(Symbol op, ExpressionPtr LHS, ExpressionPtr RHS): Expression(tag), oper(op), lhs(LHS), rhs(RHS) {}
 
-    std::string& expression_name() override {static std::string name = "[Binary]"; return name;}
+    std::string& expression_name() {static std::string name = "[Binary]"; return name;}
 };
 
 struct CallExpr: public Expression {
-    std::string callee;
-    std::vector<std::unique_ptr<Expression>> args;
+    static constexpr ExprKind tag = ExprKind::Call;
+    Symbol callee;
+    std::span<ExpressionPtr> args;
+    TypeId conversion = TypeSystem::BuiltinTypes::uninit; // set by the TypeChecker when this is a cast, not a call
 
-    CallExpr(std::string _callee, std::vector<std::unique_ptr<Expression>> _args):
-        callee(std::move(_callee)), args(std::move(_args)) {}
+    CallExpr(Symbol _callee, std::span<ExpressionPtr> _args): Expression(tag), callee(_callee), args(_args) {}
 
-    std::string& expression_name() override {static std::string name = "[Call]"; return name;}
+    std::string& expression_name() {static std::string name = "[Call]"; return name;}
 };
 
 struct IfExpr: public Expression {
-    std::unique_ptr<Expression> condition;
+    static constexpr ExprKind tag = ExprKind::If;
+    ExpressionPtr condition;
     Body then, _else;
-    IfExpr(ExpressionPtr c, Body t, Body e = {}): 
-        condition(std::move(c)), then(std::move(t)), _else(std::move(e)) {}
+    IfExpr(ExpressionPtr c, Body t, Body e = {}): Expression(tag), condition(c), then(t), _else(e) {}
 
-    std::string& expression_name() override {static std::string name = "[If]"; return name;}
+    std::string& expression_name() {static std::string name = "[If]"; return name;}
 };
 
 struct ForExpr: public Expression {
-    std::string var_name;
+    static constexpr ExprKind tag = ExprKind::For;
+    Symbol var_name;
     ExpressionPtr start, end, step;
     Body body;
-    ForExpr(std::string name, ExpressionPtr s, ExpressionPtr e, ExpressionPtr _step, Body b):
-        var_name(std::move(name)), start(std::move(s)), end(std::move(e)), step(std::move(_step)), body(std::move(b)) {}
+    TypeId type_id = TypeSystem::BuiltinTypes::uninit; // of the loop variable, resolved by the TypeChecker
+    ForExpr(Symbol name, ExpressionPtr s, ExpressionPtr e, ExpressionPtr _step, Body b):
+        Expression(tag), var_name(name), start(s), end(e), step(_step), body(b) {}
 
-    std::string& expression_name() override {static std::string name = "[For]"; return name;}
+    std::string& expression_name() {static std::string name = "[For]"; return name;}
 };
 
 struct UnaryExpr: public Expression {
-    std::string _operater;
+    static constexpr ExprKind tag = ExprKind::Unary;
+    Symbol _operater;
     ExpressionPtr operand;
 
-    UnaryExpr(std::string oper, ExpressionPtr opnd):
-        _operater(std::move(oper)), operand(std::move(opnd)) {}
+    UnaryExpr(Symbol oper, ExpressionPtr opnd): Expression(tag), _operater(oper), operand(opnd) {}
 
-    std::string& expression_name() override {static std::string name = "[Unary]"; return name;}
+    std::string& expression_name() {static std::string name = "[Unary]"; return name;}
 };
 
 struct VarDeclareExpr: public Expression {    
-    std::string type;
-    std::string name;
+    static constexpr ExprKind tag = ExprKind::VarDeclare;
+    Symbol type;
+    Symbol name;
     ExpressionPtr value;
     bool is_const;
+    TypeId type_id = TypeSystem::BuiltinTypes::uninit; // resolved by the TypeChecker
 
-    explicit VarDeclareExpr(
-        std::string _type, std::string _name, ExpressionPtr expr, bool _is_const):
-        type(std::move(_type)), name(std::move(_name)), value(std::move(expr)), is_const(_is_const) {}
+    explicit VarDeclareExpr(Symbol _type, Symbol _name, ExpressionPtr expr, bool _is_const):
+        Expression(tag), type(_type), name(_name), value(expr), is_const(_is_const) {}
 
-    std::string& expression_name() override {static std::string name = "[VarDeclare]"; return name;}
+    std::string& expression_name() {static std::string name = "[VarDeclare]"; return name;}
 };
 
 struct ReturnExpr: public Expression {
+    static constexpr ExprKind tag = ExprKind::Return;
     ExpressionPtr ret;
 
-    explicit ReturnExpr(ExpressionPtr _ret): ret(std::move(_ret)) {}  
+    explicit ReturnExpr(ExpressionPtr _ret): Expression(tag), ret(_ret) {}
 
-    std::string& expression_name() override {static std::string name = "[Return]"; return name;}
+    std::string& expression_name() {static std::string name = "[Return]"; return name;}
 };
 
+// T with the constness of E, so visiting a const node hands out const nodes
+template<typename T, typename E>
+using same_const_t = std::conditional_t<std::is_const_v<E>, const T, T>;
+
+// the node as T when it is one, nullptr otherwise
+template<typename T, typename E>
+same_const_t<T, E>* expr_cast(E* e) {
+    return e && e->kind == T::tag ? static_cast<same_const_t<T, E>*>(e) : nullptr;
+}
+
+/// calls visitor with e as its concrete node type, chosen by one switch on the kind,
+/// every overload of the visitor must return the same type
+template<typename E, typename Visitor>
+decltype(auto) visit_expression(E* e, Visitor&& visitor) {
+    static_assert(std::is_same_v<std::remove_const_t<E>, Expression>);
+    switch (e->kind) {
+    case ExprKind::Array:
+        return visitor(static_cast<same_const_t<ArrayExpr, E>*>(e));
+    case ExprKind::Literal:
+        return visitor(static_cast<same_const_t<LiteralExpr, E>*>(e));
+    case ExprKind::Variable:
+        return visitor(static_cast<same_const_t<VariableExpr, E>*>(e));
+    case ExprKind::Binary:
+        return visitor(static_cast<same_const_t<BinaryExpr, E>*>(e));
+    case ExprKind::Call:
+        return visitor(static_cast<same_const_t<CallExpr, E>*>(e));
+    case ExprKind::If:
+        return visitor(static_cast<same_const_t<IfExpr, E>*>(e));
+    case ExprKind::For:
+        return visitor(static_cast<same_const_t<ForExpr, E>*>(e));
+    case ExprKind::Unary:
+        return visitor(static_cast<same_const_t<UnaryExpr, E>*>(e));
+    case ExprKind::VarDeclare:
+        return visitor(static_cast<same_const_t<VarDeclareExpr, E>*>(e));
+    case ExprKind::Return:
+        return visitor(static_cast<same_const_t<ReturnExpr, E>*>(e));
+    }
+    assert(false && "unknown expression kind");
+    __builtin_unreachable();
+}
+
+inline std::string& Expression::expression_name() {
+    return visit_expression(this, [](auto* node) -> std::string& { return node->expression_name(); });
+}
+
+// (name, type name) of a function argument or a struct element
+using TypedName = std::pair<Symbol, Symbol>;
+
 struct ProtoType {
-    std::string name;
-    std::vector<std::pair<std::string, std::string>> args;
-    std::string answer;
-    bool is_operator_;
-    unsigned precedence_;
+    Symbol name;
+    std::span<TypedName> args;
+    Symbol answer;
+    bool is_operator_ = false;
+    unsigned precedence_ = 0;
 
-    explicit ProtoType(std::string _name, std::vector<std::pair<std::string, std::string>> _args = {},
+    explicit ProtoType(Symbol _name, std::span<TypedName> _args = {},
                 bool is_oper = false, unsigned prec = 0,
-                std::string answer_t = "uninit"):
-        name(std::move(_name)), 
-        args(std::move(_args)), 
-        answer(std::move(answer_t)), 
+                Symbol answer_t = Symbol("uninit")):
+        name(_name), 
+        args(_args), 
+        answer(answer_t), 
         is_operator_(is_oper),
         precedence_(prec) {}
 
-    ProtoType(): name(""), args() {}
+    ProtoType() = default;
+
+    // a copy whose arguments live in another arena, for prototypes kept after their parse
+    [[nodiscard]] ProtoType copy_to(Arena& arena) const {
+        ProtoType ans = *this;
+        ans.args = arena.copy<TypedName>(args.begin(), args.end());
+        return ans;
+    }
 
     friend std::ostream& operator<<(std::ostream& os, const ProtoType& t);
 
     [[nodiscard]] bool is_unary_oper() const {return is_operator_ && args.size() == 1;}
     [[nodiscard]] bool is_binary_oper() const {return is_operator_ && args.size() == 2;}
 
-    [[nodiscard]] std::string get_operator_name() const {
+    [[nodiscard]] Symbol get_operator_name() const {
         assert(is_binary_oper() || is_unary_oper());
         return name;
     }
@@ -165,38 +258,39 @@ struct ProtoType {
 };
 
 struct ExternNode {
-    std::unique_ptr<ProtoType> prototype;
+    ProtoType* prototype;
     
-    explicit ExternNode(std::unique_ptr<ProtoType> _prototype): prototype(std::move(_prototype)) {}
+    explicit ExternNode(ProtoType* _prototype): prototype(_prototype) {}
 
     friend std::ostream& operator<<(std::ostream& os, const ExternNode& t);
 };
 
 struct FunctionNode {
-    std::unique_ptr<ProtoType> prototype;
+    ProtoType* prototype;
     Body body;
 
-    FunctionNode(std::unique_ptr<ProtoType> _prototype, Body _body):
-        prototype(std::move(_prototype)), body(std::move(_body)) {}
+    FunctionNode(ProtoType* _prototype, Body _body): prototype(_prototype), body(_body) {}
 
     friend std::ostream& operator<<(std::ostream& os, const FunctionNode& t);
 };
 
 struct StructNode {
-    std::string name;
-    std::vector<std::pair<std::string, std::string>> elements;
+    Symbol name;
+    std::span<TypedName> elements;
 
-    explicit StructNode(std::string _name, std::vector<std::pair<std::string, std::string>> _elements)
-        : name(std::move(_name)), elements(std::move(_elements)) {}
+    explicit StructNode(Symbol _name, std::span<TypedName> _elements): name(_name), elements(_elements) {}
 
     friend std::ostream& operator<<(std::ostream& os, const StructNode& t);
 };
 
+/// ASTNode is one top level item, it shares the arena of its parse with the other
+/// items of that parse, the arena goes away with the last of them.
 struct ASTNode {
     std::variant<ExternNode, FunctionNode, StructNode> data;
-    explicit ASTNode(ExternNode&& e): data(std::move(e)) {};
-    explicit ASTNode(FunctionNode&& f): data(std::move(f)) {};
-    explicit ASTNode(StructNode&& s): data(std::move(s)) {};
+    std::shared_ptr<Arena> arena;
+    ASTNode(ExternNode e, std::shared_ptr<Arena> _arena): data(e), arena(std::move(_arena)) {};
+    ASTNode(FunctionNode f, std::shared_ptr<Arena> _arena): data(f), arena(std::move(_arena)) {};
+    ASTNode(StructNode s, std::shared_ptr<Arena> _arena): data(s), arena(std::move(_arena)) {};
 
     template<typename ExternVisitor, typename FunctionVisitor, typename StructNode>
     auto match(
@@ -208,7 +302,4 @@ struct ASTNode {
 };
 
 using ASTNodePtr = std::unique_ptr<ASTNode>;
-using FunctionNodePtr = std::unique_ptr<FunctionNode>;
-using ExternNodePtr = std::unique_ptr<ExternNode>;
-using StructNodePtr = std::unique_ptr<StructNode>;
-using ProtoTypePtr = std::unique_ptr<ProtoType>;
\ No newline at end of file
+using ProtoTypePtr = ProtoType*;
\ No newline at end of file
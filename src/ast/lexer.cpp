@@ -1,10 +1,230 @@
 #include "lexer.hpp"
 #include "ast/token.hpp"
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cstdint>
 #include <iostream>
+#include <string_view>
 
 #include <re2/re2.h>
 
-std::vector<Token> Lexer::tokenize(std::string target_) {
+namespace {
+
+enum class CharClass : uint8_t {
+    Invalid,
+    Space, // ' ', '\t', '\n'
+    Alpha, // first character of an identifier or keyword
+    Digit, // first character of a number
+    Hash, // comment until the end of line
+    Punctuation, // single character token, see CharTable::punctuation
+    Minus, // '-' could be an operator or the first half of '->'
+    Operator,
+};
+
+struct CharTable {
+    CharClass classes[256];
+    TokenType punctuation[256];
+    bool identifier_tail[256];
+    bool operator_tail[256];
+};
+
+// the characters which [!-'*-/:<-@\^`|~] matched in the regex version
+constexpr bool is_operator_char(unsigned char c) {
+    return (c >= '!' && c <= '\'') || (c >= '*' && c <= '/') || c == ':'
+        || (c >= '<' && c <= '@') || c == '^' || c == '`' || c == '|' || c == '~';
+}
+
+constexpr bool is_alpha(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool is_digit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+constexpr CharTable make_char_table() {
+    CharTable table {};
+    for (unsigned c = 0; c < 256; c++) {
+        table.classes[c] = CharClass::Invalid;
+        table.punctuation[c] = TokenType::Init;
+        table.identifier_tail[c] = is_alpha(c) || is_digit(c) || c == '_' || c == '%';
+        // a comment always ends the token before it
+        table.operator_tail[c] = is_operator_char(c) && c != '#';
+
+        if (is_operator_char(c)) {
+            table.classes[c] = CharClass::Operator;
+        }
+        if (is_alpha(c)) {
+            table.classes[c] = CharClass::Alpha;
+        }
+        if (is_digit(c)) {
+            table.classes[c] = CharClass::Digit;
+        }
+    }
+
+    table.classes[' '] = table.classes['\t'] = table.classes['\n'] = CharClass::Space;
+    table.classes['#'] = CharClass::Hash;
+    table.classes['-'] = CharClass::Minus;
+
+    // earlier alternatives of the regex win over the operator group
+    const std::pair<unsigned char, TokenType> punctuations[] = {
+        {';', TokenType::Delimiter},
+        {':', TokenType::Colon},
+        {'(', TokenType::LeftParenthesis},
+        {')', TokenType::RightParenthesis},
+        {'{', TokenType::LeftCurlyBrackets},
+        {'}', TokenType::RightCurlyBrackets},
+        {'[', TokenType::LeftSquareBrackets},
+        {']', TokenType::RightSquareBrackets},
+        {',', TokenType::Comma},
+        {'.', TokenType::Dot},
+    };
+    for (auto [c, type]: punctuations) {
+        table.classes[c] = CharClass::Punctuation;
+        table.punctuation[c] = type;
+    }
+    return table;
+}
+
+constexpr CharTable char_table = make_char_table();
+
+Token word_token(std::string_view word) {
+    switch (word.size()) {
+    case 2:
+        if (word == "if") return Token(TokenType::If);
+        if (word == "in") return Token(TokenType::In);
+        break;
+    case 3:
+        if (word == "def") return Token(TokenType::Def);
+        if (word == "for") return Token(TokenType::For);
+        if (word == "var") return Token(TokenType::Var, false);
+        if (word == "val") return Token(TokenType::Var, true);
+        break;
+    case 4:
+        if (word == "else") return Token(TokenType::Else);
+        if (word == "exec") return Token(TokenType::Exec);
+        break;
+    case 5:
+        if (word == "unary") return Token(TokenType::Unary);
+        break;
+    case 6:
+        if (word == "extern") return Token(TokenType::Extern);
+        if (word == "binary") return Token(TokenType::Binary);
+        if (word == "return") return Token(TokenType::Return);
+        if (word == "struct") return Token(TokenType::Struct);
+        break;
+    default:
+        break;
+    }
+    return Token(TokenType::Identifier, Symbol(word));
+}
+
+}  // namespace
+
+/// A single pass scanner, the token kind is decided by the class of the first character
+/// and comments are skipped in place instead of being stripped from a copy of the input.
+Token Lexer::next() {
+    auto peek = [&](const bool (&accept)[256]) {
+        return cursor_ != end_ && accept[static_cast<unsigned char>(*cursor_)];
+    };
+
+    while (cursor_ != end_) {
+        const char* start = cursor_;
+        auto c = static_cast<unsigned char>(*cursor_);
+        Token token;
+        switch (char_table.classes[c]) {
+        case CharClass::Space:
+            cursor_++;
+            continue;
+        case CharClass::Hash:
+            cursor_ = std::find(cursor_, end_, '\n');
+            continue;
+        case CharClass::Alpha:
+            cursor_++;
+            while (peek(char_table.identifier_tail)) cursor_++;
+            token = word_token(std::string_view(start, cursor_ - start));
+            break;
+        case CharClass::Digit: {
+            cursor_++;
+            while (cursor_ != end_ && is_digit(*cursor_)) cursor_++;
+            if (cursor_ != end_ && *cursor_ == '.') {
+                cursor_++;
+                while (cursor_ != end_ && is_digit(*cursor_)) cursor_++;
+            }
+            double num = 0;
+            std::from_chars(start, cursor_, num);
+            token = Token(TokenType::Literal, num);
+            break;
+        }
+        case CharClass::Punctuation:
+            token = Token(char_table.punctuation[c]);
+            cursor_++;
+            break;
+        case CharClass::Minus:
+            if (cursor_ + 1 != end_ && cursor_[1] == '>') {
+                token = Token(TokenType::Answer);
+                cursor_ += 2;
+                break;
+            }
+            [[fallthrough]];
+        case CharClass::Operator:
+            cursor_++;
+            if (peek(char_table.operator_tail)) cursor_++;
+            token = Token(TokenType::Operator, Symbol(std::string_view(start, cursor_ - start)));
+            break;
+        case CharClass::Invalid:
+            std::cerr << "Failed to lex input at dis: " << start - begin_ << std::endl;
+            failed_ = true;
+            cursor_ = end_;
+            continue;
+        }
+        token.set_span(start - begin_, cursor_ - start);
+        return token;
+    }
+
+    Token eof(TokenType::Eof);
+    eof.set_span(end_ - begin_, 0);
+    return eof;
+}
+
+std::vector<Token> Lexer::tokenize(std::string_view target) {
+    Lexer lexer(target);
+    std::vector<Token> ans {};
+
+    do {
+        ans.push_back(lexer.next());
+    } while (ans.back().type_ != TokenType::Eof);
+
+    if (lexer.failed()) {
+        return {};
+    }
+    return ans;
+}
+
+TokenStream::TokenStream(Lexer lexer): lexer_(lexer) {
+    ring_[head_] = lexer_.next();
+}
+
+const Token& TokenStream::peek(size_t n) {
+    assert(n + 2 <= capacity && "lookahead would overwrite the previous token");
+    while (buffered_ <= n) {
+        ring_[(head_ + buffered_) % capacity] = lexer_.next();
+        buffered_++;
+    }
+    return ring_[(head_ + n) % capacity];
+}
+
+void TokenStream::advance() {
+    head_ = (head_ + 1) % capacity;
+    buffered_--;
+    if (buffered_ == 0) {
+        ring_[head_] = lexer_.next();
+        buffered_ = 1;
+    }
+}
+
+std::vector<Token> Lexer::tokenize_re2(std::string target_) {
     static const re2::RE2 comment_regex("(?m)#.*");
     RE2::GlobalReplace(&target_, comment_regex, "");
     //std::cout << target << std::endl;
@@ -77,7 +297,7 @@ std::vector<Token> Lexer::tokenize(std::string target_) {
                     } else if (token_context == "struct") {
                         ans.emplace_back(TokenType::Struct);
                     } else {
-                        ans.emplace_back(TokenType::Identifier, std::string(token_context));
+                        ans.emplace_back(TokenType::Identifier, Symbol(std::string_view(token_context.data(), token_context.size())));
                     }
                 } else if (token_tag == "number") {
                     double num = std::stod(std::string(token_context));
@@ -101,7 +321,7 @@ std::vector<Token> Lexer::tokenize(std::string target_) {
                 } else if (token_tag == "comma") {
                     ans.emplace_back(TokenType::Comma);
                 } else if (token_tag == "operator") {
-                    ans.emplace_back(TokenType::Operator, std::string(token_context));
+                    ans.emplace_back(TokenType::Operator, Symbol(std::string_view(token_context.data(), token_context.size())));
                 } else if (token_tag == "answer") {
                     ans.emplace_back(TokenType::Answer);
                 } else if (token_tag == "dot") {
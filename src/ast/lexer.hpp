@@ -1,10 +1,53 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "token.hpp"
 
+/// Lexer produces tokens one at a time from a source it does not own,
+/// after the end of input it keeps returning Eof.
 class Lexer {
 public:
-    static std::vector<Token> tokenize(std::string target);
-};
\ No newline at end of file
+    explicit Lexer(std::string_view source)
+        : begin_(source.data()), end_(source.data() + source.size()), cursor_(begin_) {}
+    // lexes source[from, to) only, spans still count from the start of source
+    Lexer(std::string_view source, size_t from, size_t to)
+        : begin_(source.data()), end_(source.data() + to), cursor_(source.data() + from) {}
+
+    Token next();
+    [[nodiscard]] bool failed() const { return failed_; }
+
+    static std::vector<Token> tokenize(std::string_view target);
+    // the regex based scanner which tokenize() replaced, kept for benchmark and cross checking
+    static std::vector<Token> tokenize_re2(std::string target);
+private:
+    const char* begin_;
+    const char* end_;
+    const char* cursor_;
+    bool failed_ = false;
+};
+
+/// TokenStream pulls from a Lexer on demand. It keeps the previous token and a few
+/// lookahead tokens in a fixed ring, so memory stays flat however long the input is.
+class TokenStream {
+public:
+    explicit TokenStream(Lexer lexer);
+
+    [[nodiscard]] const Token& current() const { return ring_[head_]; }
+    [[nodiscard]] const Token& previous() const { return ring_[(head_ + capacity - 1) % capacity]; }
+    const Token& peek(size_t n);
+    void advance();
+
+    [[nodiscard]] bool failed() const { return lexer_.failed(); }
+private:
+    static constexpr size_t capacity = 8;
+
+    Lexer lexer_;
+    std::array<Token, capacity> ring_ {};
+    size_t head_ = 0;
+    size_t buffered_ = 1; // tokens already lexed, counting from the current one
+};
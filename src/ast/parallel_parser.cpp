@@ -0,0 +1,170 @@
+#include "parallel_parser.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+namespace {
+
+// a piece handed to one worker is at least this large, tiny items are batched together
+constexpr size_t min_piece_bytes = 16 * 1024;
+// pieces per thread, so that a slow piece does not leave the other threads idle
+constexpr size_t pieces_per_thread = 8;
+
+bool is_word_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+        || c == '_' || c == '%';
+}
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+std::string_view word_at(std::string_view source, size_t pos) {
+    size_t end = pos;
+    while (end < source.size() && is_word_char(source[end])) end++;
+    return source.substr(pos, end - pos);
+}
+
+}  // namespace
+
+std::vector<ParallelParser::Item> ParallelParser::split_top_level(std::string_view source) {
+    std::vector<size_t> starts = {0};
+    std::vector<bool> operators = {false};
+    int depth = 0;
+
+    size_t i = 0;
+    while (i < source.size()) {
+        char c = source[i];
+        if (c == '#') {
+            auto newline = source.find('\n', i);
+            i = newline == std::string_view::npos ? source.size() : newline;
+            continue;
+        }
+        if (c == '{' || c == '(' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ')' || c == ']') {
+            depth--;
+        }
+        if (!is_word_char(c)) {
+            i++;
+            continue;
+        }
+
+        auto word = word_at(source, i);
+        if (depth == 0 && (word == "def" || word == "extern" || word == "struct" || word == "exec")) {
+            // 'def binary' and 'extern unary' register a precedence while being parsed
+            size_t next = i + word.size();
+            while (next < source.size() && is_space(source[next])) next++;
+            auto following = word_at(source, next);
+            bool defines_operator = following == "binary" || following == "unary";
+
+            if (starts.back() == i) {
+                operators.back() = defines_operator;
+            } else {
+                starts.push_back(i);
+                operators.push_back(defines_operator);
+            }
+        }
+        i += word.size();
+    }
+
+    std::vector<Item> items;
+    items.reserve(starts.size());
+    for (size_t k = 0; k < starts.size(); k++) {
+        size_t end = k + 1 < starts.size() ? starts[k + 1] : source.size();
+        items.push_back({starts[k], end, operators[k]});
+    }
+    return items;
+}
+
+std::vector<ASTNodePtr> ParallelParser::parse() {
+    if (threads_ == 1) {
+        // nothing to share the pieces with, one Parser registers the operators as it goes
+        return parse_range(0, source_.size());
+    }
+    auto items = split_top_level(source_);
+    std::vector<ASTNodePtr> ans;
+
+    size_t first = 0;
+    for (size_t k = 0; k <= items.size() && !failed_; k++) {
+        if (k < items.size() && !items[k].defines_operator) {
+            continue;
+        }
+        parse_parallel(items, first, k, ans);
+        if (k < items.size() && !failed_) {
+            auto nodes = parse_range(items[k].begin, items[k].end);
+            std::move(nodes.begin(), nodes.end(), std::back_inserter(ans));
+        }
+        first = k + 1;
+    }
+
+    if (failed_) {
+        return {};
+    }
+    return ans;
+}
+
+std::vector<ASTNodePtr> ParallelParser::parse_range(size_t begin, size_t end) {
+    auto parser = Parser(Lexer(source_, begin, end), operator_precedence_);
+    auto nodes = parser.parse();
+    if (parser.failed()) {
+        failed_ = true;
+        return {};
+    }
+    return nodes;
+}
+
+/// parses items[first, last), none of them defines an operator, so the workers
+/// only ever read the shared precedence table
+void ParallelParser::parse_parallel(const std::vector<Item>& items, size_t first, size_t last,
+    std::vector<ASTNodePtr>& ans) {
+    if (first >= last) {
+        return;
+    }
+
+    size_t bytes = items[last - 1].end - items[first].begin;
+    size_t piece_bytes = std::max(min_piece_bytes, bytes / (threads_ * pieces_per_thread));
+    std::vector<std::pair<size_t, size_t>> pieces;
+    for (size_t k = first; k < last; k++) {
+        if (pieces.empty() || items[k].end - pieces.back().first > piece_bytes) {
+            pieces.emplace_back(items[k].begin, items[k].end);
+        } else {
+            pieces.back().second = items[k].end;
+        }
+    }
+
+    std::vector<std::vector<ASTNodePtr>> results(pieces.size());
+    std::atomic<size_t> next_piece = 0;
+    std::atomic<bool> failed = false;
+    auto work = [&]() {
+        for (size_t k = next_piece++; k < pieces.size() && !failed; k = next_piece++) {
+            auto parser = Parser(Lexer(source_, pieces[k].first, pieces[k].second), operator_precedence_);
+            results[k] = parser.parse();
+            if (parser.failed()) {
+                failed = true;
+            }
+        }
+    };
+
+    auto workers_count = std::min<size_t>(threads_, pieces.size());
+    std::vector<std::thread> workers;
+    workers.reserve(workers_count - 1);
+    for (size_t k = 1; k < workers_count; k++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker: workers) {
+        worker.join();
+    }
+
+    if (failed) {
+        failed_ = true;
+        return;
+    }
+    for (auto& result: results) {
+        std::move(result.begin(), result.end(), std::back_inserter(ans));
+    }
+}
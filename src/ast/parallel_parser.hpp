@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hpp"
+#include "symbol.hpp"
+
+/// ParallelParser cuts a source at its top level items and parses the pieces on a
+/// pool of threads, one Parser per piece, the results keep the source order.
+/// Operator definitions change how everything after them parses, so each of them
+/// is parsed alone once all the pieces before it are done.
+class ParallelParser {
+public:
+    struct Item {
+        size_t begin;
+        size_t end;
+        bool defines_operator;
+    };
+
+    ParallelParser(std::string_view source, std::unordered_map<Symbol, int>& prec,
+        unsigned threads = std::thread::hardware_concurrency())
+        : source_(source), operator_precedence_(prec), threads_(threads == 0 ? 1 : threads) {}
+
+    std::vector<ASTNodePtr> parse();
+    [[nodiscard]] bool failed() const { return failed_; }
+
+    // a scan over the characters only, without lexing: an item starts at every
+    // 'def', 'extern', 'struct' or 'exec' outside of any brackets
+    static std::vector<Item> split_top_level(std::string_view source);
+private:
+    std::vector<ASTNodePtr> parse_range(size_t begin, size_t end);
+    void parse_parallel(const std::vector<Item>& items, size_t first, size_t last,
+        std::vector<ASTNodePtr>& ans);
+private:
+    std::string_view source_;
+    std::unordered_map<Symbol, int>& operator_precedence_;
+    unsigned threads_;
+    bool failed_ = false;
+};
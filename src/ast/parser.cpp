@@ -11,39 +11,58 @@
 #include <vector>
 
 std::vector<ASTNodePtr> Parser::parse() {
-    bool end = false;
-    while (!end) {
-        switch (current_token_type()) {
-        case TokenType::Eof:
-            end = true;
-            break;
-        case TokenType::Def:
-            parse_definition();
-            break;
-        case TokenType::Extern:
-            parse_extern();
-            break;
-        case TokenType::Struct:
-            parse_struct_definition();
-            break;
-        case TokenType::Delimiter:
-            next_token();
-            break;
-        case TokenType::Exec:
-            parse_top_level_expression();
-            break;            
-        default:
-            std::cerr << "cannot parse input" << std::endl;
-            return {};
-        }
-        
-        if (!err_.empty()) {
+    std::vector<ASTNodePtr> ans;
+    while (auto node = parse_top_level()) {
+        ans.push_back(std::move(node));
+    }
+
+    if (failed()) {
+        return {};
+    }
+    return ans;
+}
+
+ASTNodePtr Parser::parse_top_level() {
+    while (current_token_type() == TokenType::Delimiter) {
+        next_token();
+    }
+
+    switch (current_token_type()) {
+    case TokenType::Eof:
+        return nullptr;
+    case TokenType::Def:
+        parse_definition();
+        break;
+    case TokenType::Extern:
+        parse_extern();
+        break;
+    case TokenType::Struct:
+        parse_struct_definition();
+        break;
+    case TokenType::Exec:
+        parse_top_level_expression();
+        break;
+    default:
+        err_ = "cannot parse input";
+        break;
+    }
+
+    if (err_.empty() && ast_tree_.empty()) {
+        err_ = "cannot parse input";
+    }
+    if (!err_.empty()) {
+        // a lexing error has been reported already, the parse error is only its echo
+        if (!tokens_.failed()) {
             std::cerr << err_ << std::endl;
-            return {};
         }
+        ast_tree_.clear();
+        scratch_.clear();
+        return nullptr;
     }
 
-    return std::move(ast_tree_);
+    auto node = std::move(ast_tree_.back());
+    ast_tree_.pop_back();
+    return node;
 }
 
 void Parser::parse_struct_definition() {
@@ -53,7 +72,7 @@ void Parser::parse_struct_definition() {
         err_ = "expect struct-name before struct";
         return;
     }
-    std::string name = token_iter_->get_string(); 
+    Symbol name = current_token().get_symbol(); 
     next_token(); // eat struct name
 
     if (current_token_type() != TokenType::LeftCurlyBrackets) {
@@ -63,13 +82,13 @@ void Parser::parse_struct_definition() {
 
     next_token(); // eat '{'
 
-    std::vector<std::pair<std::string, std::string>> elements {};
+    std::vector<TypedName> elements {};
     while (current_token_type() != TokenType::RightCurlyBrackets) {
         if (current_token_type() != TokenType::Identifier) {
             err_ = "expect struct-element-name in struct content";
             return;
         }
-        std::string element_name = token_iter_->get_string(); 
+        Symbol element_name = current_token().get_symbol(); 
         next_token();
         if (current_token_type() != TokenType::Colon) {
             err_ = "expect struct ':' before struct-element-name";
@@ -80,7 +99,7 @@ void Parser::parse_struct_definition() {
             err_ = "expect struct-element-type before ':'";
             return;
         }
-        std::string element_type = token_iter_->get_string(); 
+        Symbol element_type = current_token().get_symbol(); 
         next_token();        
 
         if (current_token_type() != TokenType::Comma) {
@@ -97,15 +116,14 @@ void Parser::parse_struct_definition() {
     }
 
     next_token(); // eat '}'
-    ast_tree_.push_back(std::make_unique<ASTNode>(StructNode{name, elements}));
+    ast_tree_.push_back(std::make_unique<ASTNode>(StructNode{name, arena_->copy(elements)}, arena_));
 }
 
 /// top_level_expression ::= expression
 void Parser::parse_top_level_expression() {
     next_token(); // eat 'exec'
 
-    // std::unique_ptr<TypeSystem::TypeBase> result_type = std::make_unique<TypeSystem::UninitType>();
-    std::string result_type = "uninit";
+    Symbol result_type("uninit");
 
     if (current_token_type() == TokenType::Colon) {
         next_token(); // eat ':'
@@ -113,7 +131,7 @@ void Parser::parse_top_level_expression() {
             err_ = "expect type-id before 'exec:'";
             return;
         }
-        result_type = token_iter_->get_string();
+        result_type = current_token().get_symbol();
         next_token();
     }
 
@@ -122,16 +140,14 @@ void Parser::parse_top_level_expression() {
         return;
     }
 
-    Body body = {};
-    auto ret = std::make_unique<ReturnExpr>(std::move(expression));
-    body.data.push_back(std::move(ret));
-    body.has_return_value = false;
+    ExpressionPtr ret = arena_->make<ReturnExpr>(expression);
+    Body body = {arena_->copy<ExpressionPtr>(&ret, &ret + 1), false};
 
     // std::cout << "Parsed a top-level expr." << std::endl;
     
-    auto proto = std::make_unique<ProtoType>("__anon_expr");
-    proto->answer = std::move(result_type); 
-    ast_tree_.push_back(std::make_unique<ASTNode>(FunctionNode{std::move(proto), std::move(body)}));
+    auto proto = arena_->make<ProtoType>(Symbols::anon_expr);
+    proto->answer = result_type; 
+    ast_tree_.push_back(std::make_unique<ASTNode>(FunctionNode{proto, body}, arena_));
 }
 
 /// definition ::= 'def' prototype { body }
@@ -164,8 +180,7 @@ void Parser::parse_definition() {
     next_token(); // eat }
     // std::cout << "Parsed a function definition." << std::endl;
 
-    //ast_tree_.push_back(std::make_unique<ASTNode>(FunctionNode{std::move(proto), std::move(expression)}));
-    ast_tree_.push_back(std::make_unique<ASTNode>(FunctionNode{std::move(proto), std::move(body)}));
+    ast_tree_.push_back(std::make_unique<ASTNode>(FunctionNode{proto, body}, arena_));
 }
 
 /// external ::= 'extern' prototype
@@ -175,12 +190,12 @@ void Parser::parse_extern() {
 
     // std::cout << "Parsed an extern." << std::endl;
 
-    ast_tree_.push_back(std::make_unique<ASTNode>(ExternNode{std::move(proto)}));
+    ast_tree_.push_back(std::make_unique<ASTNode>(ExternNode{proto}, arena_));
 }
 
 /// body ::= (expression;)* return_expression;
 Body Parser::parse_body() {
-    Body body;
+    size_t from = scratch_.size();
 
     bool returned = false;
     while (current_token_type() != TokenType::RightCurlyBrackets) {
@@ -208,10 +223,9 @@ Body Parser::parse_body() {
             }
             returned = true;
         }
-        body.data.push_back(std::move(line));
+        scratch_.push_back(line);
     }
-    body.has_return_value = returned;
-    return body;
+    return {take_scratch(from), returned};
 }
 
 /// expression ::= primary binoprhs
@@ -221,19 +235,19 @@ ExpressionPtr Parser::parse_expression() {
         return nullptr;
     }
 
-    return parse_binary_op_rhs(0, std::move(lhs));
+    return parse_binary_op_rhs(0, lhs);
 }
 
 /// prototype ::= id '(' id* ')' 
 /// id in parenthesis are splited by ','
 ProtoTypePtr Parser::parse_prototype() {
-    std::string name = "";
+    Symbol name;
     unsigned kind = 0; // 0 = ident, 1 = unary, 2 = binary
     int binary_precedence = 30;
 
     switch (current_token_type()) {
         case TokenType::Identifier:
-            name = token_iter_->get_string();
+            name = current_token().get_symbol();
             next_token();
             kind = 0;
             break;
@@ -243,12 +257,12 @@ ProtoTypePtr Parser::parse_prototype() {
                 err_ = "Expected binary operator";
                 return nullptr;
             }
-            name = token_iter_->get_string();
+            name = current_token().get_symbol();
             kind = 2;
             next_token(); // eat operator
 
             if (current_token_type() == TokenType::Literal) {
-                double num = token_iter_->get_literal();
+                double num = current_token().get_literal();
                 if (num < 1 || num > 100) {
                     err_ = "Invalid precedence: must be 1..100";
                     return nullptr;
@@ -265,7 +279,7 @@ ProtoTypePtr Parser::parse_prototype() {
                 return nullptr;
             }
 
-            name = token_iter_->get_string();
+            name = current_token().get_symbol();
             kind = 1;
             operator_precedence_[name] = 10000; // max precedence
             next_token(); // eat operator
@@ -281,17 +295,17 @@ ProtoTypePtr Parser::parse_prototype() {
     }
 
     next_token();
-    std::vector<std::pair<std::string, std::string>> args{};
+    std::vector<TypedName> args{};
     while (current_token_type() != TokenType::RightParenthesis) {
         if (current_token_type() == TokenType::Identifier) {
-            args.emplace_back((*token_iter_).get_string(), "error");
+            args.emplace_back(current_token().get_symbol(), Symbol("error"));
             next_token();
             if (current_token_type() != TokenType::Colon) {
                 err_ = "Expected ':' after identifier";
                 return nullptr;
             }
             next_token(); // eat ':'
-            args.back().second = token_iter_->get_string();
+            args.back().second = current_token().get_symbol();
             next_token(); // eat type
 
             if (current_token_type() == TokenType::Comma) {
@@ -313,14 +327,14 @@ ProtoTypePtr Parser::parse_prototype() {
     }
     next_token(); // eat ')'
 
-    std::string return_type = "void";
+    Symbol return_type("void");
     if (current_token_type() == TokenType::Answer) {
         next_token(); // eat '->'
         if (current_token_type() != TokenType::Identifier) {
             err_ = "Expected type before '->'";
             return nullptr;
         }
-        return_type = token_iter_->get_string();
+        return_type = current_token().get_symbol();
         next_token(); // eat type
     }
 
@@ -329,7 +343,7 @@ ProtoTypePtr Parser::parse_prototype() {
         return nullptr;
     }
 
-    return std::make_unique<ProtoType>(name, std::move(args), kind != 0, binary_precedence, std::move(return_type));
+    return arena_->make<ProtoType>(name, arena_->copy(args), kind != 0, binary_precedence, return_type);
 }
 
 /// binoprhs::= [operator primary]*
@@ -347,7 +361,7 @@ ExpressionPtr Parser::parse_binary_op_rhs(int prec, ExpressionPtr lhs) {
         }
 
         // Okay, we know this is a binop.
-        std::string oper = (*token_iter_).get_string();
+        Symbol oper = current_token().get_symbol();
         next_token();
 
         // Parse the primary expression after the binary operator.
@@ -360,13 +374,13 @@ ExpressionPtr Parser::parse_binary_op_rhs(int prec, ExpressionPtr lhs) {
         // the pending operator take RHS as its LHS.
         int next_prec = current_token_precedence();
         if (current_prec < next_prec) {
-            rhs = parse_binary_op_rhs(current_prec + 1, std::move(rhs));
+            rhs = parse_binary_op_rhs(current_prec + 1, rhs);
             if (!rhs) {
                 return nullptr;
             }
         }
 
-        lhs = std::make_unique<BinaryExpr>(oper, std::move(lhs), std::move(rhs));
+        lhs = arena_->make<BinaryExpr>(oper, lhs, rhs);
     }
 }
 
@@ -397,7 +411,7 @@ ExpressionPtr Parser::parse_primary() {
 
 /// varexpr ::= ['var'|'val'] identifier ':' type ('=' expression)?
 ExpressionPtr Parser::parse_var_declare_expr() {
-    bool is_const = token_iter_->is_const();
+    bool is_const = current_token().is_const();
     next_token(); // eat var
 
     if (current_token_type() != TokenType::Identifier) {
@@ -405,7 +419,7 @@ ExpressionPtr Parser::parse_var_declare_expr() {
         return nullptr;
     }
 
-    std::string name = token_iter_->get_string();
+    Symbol name = current_token().get_symbol();
     next_token(); // eat identifier
 
     if (current_token_type() != TokenType::Colon) {
@@ -418,11 +432,11 @@ ExpressionPtr Parser::parse_var_declare_expr() {
         err_ = "expected type after colon";
         return nullptr;
     }
-    std::string type = token_iter_->get_string();
+    Symbol type = current_token().get_symbol();
     next_token(); // eat type
 
     ExpressionPtr init = nullptr;
-    if (current_token_type() == TokenType::Operator && token_iter_->get_string() == "=") {
+    if (current_token_type() == TokenType::Operator && current_token().get_symbol() == Symbols::assign) {
         next_token(); // eat the '=';
 
         init = parse_primary();
@@ -431,7 +445,7 @@ ExpressionPtr Parser::parse_var_declare_expr() {
 
     // names.emplace_back(name, std::move(init));
 
-    return std::make_unique<VarDeclareExpr>(std::move(type), name, std::move(init), is_const);
+    return arena_->make<VarDeclareExpr>(type, name, init, is_const);
 }
 
 /// forexpr ::= 'for' '(' identifier '=' expr ',' expr (',' expr)? ')' { body }
@@ -449,10 +463,10 @@ ExpressionPtr Parser::parse_for_expr() {
         return nullptr;
     }
 
-    std::string variant_name = token_iter_->get_string();
+    Symbol variant_name = current_token().get_symbol();
     next_token(); // eat cycle variant
 
-    if (current_token_type() != TokenType::Operator && token_iter_->get_string() != "=") {
+    if (current_token_type() != TokenType::Operator && current_token().get_symbol() != Symbols::assign) {
         err_ = "expected '=' after identifier";
         return nullptr;
     }
@@ -474,7 +488,7 @@ ExpressionPtr Parser::parse_for_expr() {
     }
 
     // The step value is optional.
-    ExpressionPtr step;
+    ExpressionPtr step = nullptr;
     if (current_token_type() == TokenType::Comma) {
         next_token(); // eat ','
         step = parse_expression();
@@ -506,13 +520,7 @@ ExpressionPtr Parser::parse_for_expr() {
     }
     next_token(); // eat '}'
 
-    return std::make_unique<ForExpr>(
-        variant_name,
-        std::move(start),
-        std::move(end),
-        std::move(step),
-        std::move(body)
-    );
+    return arena_->make<ForExpr>(variant_name, start, end, step, body);
 }
 
 /// ifexpr ::= 'if' '(' expression ')' '{' body '}' ('else' '{' body '}')?
@@ -551,7 +559,7 @@ ExpressionPtr Parser::parse_if_expr() {
     next_token(); // eat '}'
 
     if (current_token_type() != TokenType::Else) {
-        return std::make_unique<IfExpr>(std::move(cond), std::move(then));
+        return arena_->make<IfExpr>(cond, then);
     }
     next_token(); // eat else
 
@@ -570,14 +578,14 @@ ExpressionPtr Parser::parse_if_expr() {
     }
     next_token(); // eat '}'
 
-    return std::make_unique<IfExpr>(std::move(cond), std::move(then), std::move(_else));
+    return arena_->make<IfExpr>(cond, then, _else);
 }
 
 /// return ::= 'return' expression;
 ExpressionPtr Parser::parse_return_expr() {
     next_token(); // eat return
     auto ret = parse_expression();
-    return std::make_unique<ReturnExpr>(std::move(ret));
+    return arena_->make<ReturnExpr>(ret);
 }
 
 /// unary
@@ -601,10 +609,10 @@ ExpressionPtr Parser::parse_unary() {
     }
 
     if (current_token_type() == TokenType::Operator) {
-        std::string name = token_iter_->get_string();
+        Symbol name = current_token().get_symbol();
         next_token(); // eat unary 
         if (auto opnd = parse_unary()) {
-            return std::make_unique<UnaryExpr>(name, std::move(opnd));
+            return arena_->make<UnaryExpr>(name, opnd);
         }
     }
 
@@ -616,21 +624,25 @@ ExpressionPtr Parser::parse_unary() {
 ///                ::= identifier
 ///                ::= identifier [ '[' expression ']' ]*
 ///                ::= identifier [ '.' expression]*
+///                ::= 'true' | 'false'
 /// expression in parenthesis are splited by ','
 ExpressionPtr Parser::parse_identifier_expr() {
-    std::string name = (*token_iter_).get_string();
+    Symbol name = current_token().get_symbol();
     next_token(); // eat name
 
+    if (name == Symbols::true_literal || name == Symbols::false_literal) {
+        return arena_->make<LiteralExpr>(name == Symbols::true_literal ? 1.0 : 0.0, Symbol("bool"));
+    }
+
     // variable
     if (current_token_type() != TokenType::LeftParenthesis
         && current_token_type() != TokenType::LeftSquareBrackets
         && current_token_type() != TokenType::Dot) {
-        return std::make_unique<VariableExpr>(name); 
+        return arena_->make<VariableExpr>(name); 
     }
 
     if (current_token_type() == TokenType::LeftSquareBrackets || current_token_type() == TokenType::Dot) {
         // offset address
-        std::vector<ExpressionPtr> offset_indexes {};
         std::vector<VariableExpr::Addr> addrs {};
 
         bool all_array = true;
@@ -643,7 +655,7 @@ ExpressionPtr Parser::parse_identifier_expr() {
                     err_ = "expect identifier before '.'";
                     return nullptr;
                 } 
-                addrs.emplace_back(token_iter_->get_string());
+                addrs.emplace_back(VariableExpr::Field {current_token().get_symbol()});
                 next_token(); // eat Identifier             
             } else {
                 next_token(); // eat '['
@@ -652,7 +664,7 @@ ExpressionPtr Parser::parse_identifier_expr() {
                     err_ = "need value in []";
                     return nullptr;
                 }
-                addrs.emplace_back(std::move(index));
+                addrs.emplace_back(index);
                 if (current_token_type() == TokenType::RightSquareBrackets) {
                     next_token(); // eat ']'
                 } else {
@@ -661,17 +673,17 @@ ExpressionPtr Parser::parse_identifier_expr() {
                 }                
             }
         }
-        return std::make_unique<VariableExpr>(name, std::move(addrs), all_array); 
+        return arena_->make<VariableExpr>(name, arena_->copy(addrs), all_array); 
     }
 
     if (current_token_type() == TokenType::LeftParenthesis) {
         // call
         next_token(); // eat '('
-        std::vector<ExpressionPtr> args{};
+        size_t from = scratch_.size();
         if (current_token_type() != TokenType::RightParenthesis) {
             while (true) {
                 if (auto arg = parse_expression()) {
-                    args.push_back(std::move(arg));
+                    scratch_.push_back(arg);
                 } else {
                     return nullptr;
                 }
@@ -689,16 +701,16 @@ ExpressionPtr Parser::parse_identifier_expr() {
         }
         next_token(); // eat ')'
 
-        return std::make_unique<CallExpr>(name, std::move(args));
+        return arena_->make<CallExpr>(name, take_scratch(from));
     }
     return nullptr;
 }
 
 /// literalexpr ::= literal
 ExpressionPtr Parser::parse_literal_expr() {
-    double val = (*token_iter_).get_literal();
+    double val = current_token().get_literal();
     next_token();
-    std::string type = "uninit";
+    Symbol type("uninit");
     if (current_token_type() == TokenType::Colon) {
         next_token(); // eat ':'
 
@@ -706,11 +718,10 @@ ExpressionPtr Parser::parse_literal_expr() {
             err_ = "expected type after colon";
             return nullptr;
         }
-        type = token_iter_->get_string();
+        type = current_token().get_symbol();
         next_token(); // eat type        
     }
-    auto res = std::make_unique<LiteralExpr>(val, std::move(type));
-    return res;
+    return arena_->make<LiteralExpr>(val, type);
 }
 
 /// parenexpr ::= '(' expression ')'
@@ -731,14 +742,14 @@ ExpressionPtr Parser::parse_parenthesis_expr() {
 
 /// square_array_expr ::= '[' expression [',' expression]* ']' ':' type
 ExpressionPtr Parser::parse_square_array_expr() {
-    std::vector<ExpressionPtr> elements;
+    size_t from = scratch_.size();
     
     next_token(); // eat '[';
     auto element = parse_unary();
     if (!element) {
         return nullptr;
     }
-    elements.push_back(std::move(element));
+    scratch_.push_back(element);
 
     while (current_token_type() == TokenType::Comma) {
         next_token(); // eat ','
@@ -746,7 +757,7 @@ ExpressionPtr Parser::parse_square_array_expr() {
         if (!_element) {
             return nullptr;
         }
-        elements.push_back(std::move(_element));            
+        scratch_.push_back(_element);
     }
 
     if (current_token_type() != TokenType::RightSquareBrackets) {
@@ -765,18 +776,17 @@ ExpressionPtr Parser::parse_square_array_expr() {
         err_ = "expected type before ':'";
         return nullptr;
     }
-    std::string type = token_iter_->get_string();
-    type = "array%" + type + '%' + std::to_string(elements.size());
+    auto elements = take_scratch(from);
+    Symbol type("array%" + std::string(current_token().get_string()) + '%' + std::to_string(elements.size()));
     next_token();
-    return std::make_unique<ArrayExpr>(std::move(elements), std::move(type));
+    return arena_->make<ArrayExpr>(elements, type);
 }
 
 int Parser::current_token_precedence() {
-    if (token_iter_ == tokens_.end()) return -1;
-
     if (current_token_type() == TokenType::Operator) {
-        if (operator_precedence_.count((*token_iter_).get_string())) {
-            return operator_precedence_[(*token_iter_).get_string()];
+        auto iter = operator_precedence_.find(current_token().get_symbol());
+        if (iter != operator_precedence_.end()) {
+            return iter->second;
         } else {
             return -1;
         }
@@ -786,11 +796,11 @@ int Parser::current_token_precedence() {
 }
 
 bool Parser::prev_token_is_right_curly_brackets() {
-    token_iter_--;
-    if (current_token_type() == TokenType::RightCurlyBrackets) {
-        token_iter_++;
-        return true;
-    }
-    token_iter_++;
-    return false;
-}
\ No newline at end of file
+    return tokens_.previous().type_ == TokenType::RightCurlyBrackets;
+}
+
+std::span<ExpressionPtr> Parser::take_scratch(size_t from) {
+    auto ans = arena_->copy<ExpressionPtr>(scratch_.begin() + from, scratch_.end());
+    scratch_.resize(from);
+    return ans;
+}
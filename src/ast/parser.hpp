@@ -4,23 +4,30 @@
 #include <cassert>
 #include <iterator>
 #include <map>
+#include <memory>
+#include <span>
 #include <exception>
 #include <optional>
 #include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "arena.hpp"
 #include "ast.hpp"
+#include "lexer.hpp"
 #include "token.hpp"
 
 class Parser {
 public:
-    explicit Parser(std::vector<Token>&& v, std::map<std::string, int>& prec)
-        : tokens_(std::move(v)), operator_precedence_(prec) {
-        token_iter_ = tokens_.begin();
-    }
+    explicit Parser(Lexer lexer, std::unordered_map<Symbol, int>& prec)
+        : tokens_(lexer), arena_(std::make_shared<Arena>()), operator_precedence_(prec) {}
 
     std::vector<ASTNodePtr> parse();
+    // the next top level item, or nullptr at the end of input and on errors
+    ASTNodePtr parse_top_level();
+    [[nodiscard]] bool failed() const { return !err_.empty() || tokens_.failed(); }
+
     void parse_top_level_expression();
     void parse_definition();
     void parse_extern();
@@ -43,15 +50,18 @@ public:
     ExpressionPtr parse_parenthesis_expr();
     ExpressionPtr parse_square_array_expr();
 private:
-    TokenType current_token_type() { return token_iter_->type_; }
-    void next_token() { token_iter_++; }
+    const Token& current_token() const { return tokens_.current(); }
+    TokenType current_token_type() const { return tokens_.current().type_; }
+    void next_token() { tokens_.advance(); }
     int current_token_precedence();
     bool prev_token_is_right_curly_brackets();
+    // moves scratch_[from, end) into the arena, nested lists reuse the same scratch
+    std::span<ExpressionPtr> take_scratch(size_t from);
 private:
-    using TokenVecIter = std::vector<Token>::iterator;
-    std::vector<Token> tokens_;
+    TokenStream tokens_;
+    std::shared_ptr<Arena> arena_;
+    std::vector<ExpressionPtr> scratch_;
     std::vector<ASTNodePtr> ast_tree_;
-    TokenVecIter token_iter_;
     std::string err_;
-    std::map<std::string, int>& operator_precedence_;
+    std::unordered_map<Symbol, int>& operator_precedence_;
 };
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "symbol.hpp"
+
+/// ScopedTable keeps the bindings of all open scopes in one flat stack. Every name points
+/// at its innermost binding and each binding at the one it shadows, so a lookup is one
+/// index by symbol id whatever the nesting, and closing a scope restores what it shadowed.
+template<typename Value>
+class ScopedTable {
+public:
+    void bind(Symbol name, Value value) {
+        if (innermost_.size() <= name.id) {
+            innermost_.resize(name.id + 1, none);
+        }
+        bindings_.push_back({name, std::move(value), innermost_[name.id]});
+        innermost_[name.id] = static_cast<uint32_t>(bindings_.size() - 1);
+    }
+
+    // the innermost binding of name, nullptr when it is unbound
+    Value* find(Symbol name) {
+        if (name.id >= innermost_.size() || innermost_[name.id] == none) {
+            return nullptr;
+        }
+        return &bindings_[innermost_[name.id]].value;
+    }
+    const Value* find(Symbol name) const { return const_cast<ScopedTable*>(this)->find(name); }
+
+    void step() {
+        scope_starts_.push_back(static_cast<uint32_t>(bindings_.size()));
+    }
+
+    void back() {
+        assert(!scope_starts_.empty() && "no scope to close");
+        unbind_down_to(scope_starts_.back());
+        scope_starts_.pop_back();
+    }
+
+    // the bindings outside of any scope go too
+    void clear() {
+        // restoring only what was bound keeps this proportional to the item, not to the session
+        unbind_down_to(0);
+        scope_starts_.clear();
+    }
+private:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct Binding {
+        Symbol name;
+        Value value;
+        uint32_t shadowed; // the binding of the same name this one hides
+    };
+
+    void unbind_down_to(uint32_t size) {
+        while (bindings_.size() > size) {
+            innermost_[bindings_.back().name.id] = bindings_.back().shadowed;
+            bindings_.pop_back();
+        }
+    }
+
+    std::vector<Binding> bindings_;
+    std::vector<uint32_t> scope_starts_;
+    std::vector<uint32_t> innermost_; // by symbol id, none when unbound
+};
@@ -1,6 +1,7 @@
 #include "semantic.hpp"
 #include "ast/ast.hpp"
 #include "ast/type.hpp"
+#include "utils/rustic_match.hpp"
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
@@ -11,91 +12,67 @@
 
 namespace Semantic {
 
-void NaiveSymbolTable::add_symbol(std::string& name, std::string& type) {
-    table_.back().insert({name, type});
-}
-
-std::string& NaiveSymbolTable::find_symbol_type(std::string& name) {
-    for (auto iter = table_.rbegin(); iter != table_.rend(); iter++) {
-        if (iter->count(name)) {
-            return (*iter)[name];
-        }
+void SignatureTable::add(Symbol name, const ProtoType& proto, TypeManager& type_manager) {
+    auto offset = static_cast<uint32_t>(types_.size());
+    types_.push_back(type_manager.find_type_by_name(proto.answer)->id);
+    for (auto& arg: proto.args) {
+        types_.push_back(type_manager.find_type_by_name(arg.second)->id);
     }
-
-    return my_error_;
+    // a redefinition leaves its old entry unused in the pool
+    signatures_[name] = {offset, static_cast<uint32_t>(types_.size()) - offset};
 }
 
-void NaiveSymbolTable::step() {
-    table_.emplace_back();
-}
-
-void NaiveSymbolTable::back() {
-    table_.pop_back();
-}
-
-void NaiveSymbolTable::clear() {
-    table_ = {{}};
+std::span<const TypeId> SignatureTable::find(Symbol name) const {
+    auto found = signatures_.find(name);
+    if (found == signatures_.end()) {
+        return {};
+    }
+    return {types_.data() + found->second.offset, found->second.size};
 }
 
 }  // namespace Semantic
 
+using namespace TypeSystem::BuiltinTypes;
+
 bool TypeChecker::check(ASTNode& node) {
+    static const Symbol uninit_type("uninit");
+
     symbol_table_.clear();
+    untyped_literals_.clear();
     return node.match(
         [&](ExternNode& e) -> bool {
-            std::vector<std::string> types {};
-            types.push_back(e.prototype->answer);
-            for (auto& arg: e.prototype->args) {
-                types.push_back(arg.second);
-            }
-            function_table_[e.prototype->name] = types;
-
+            function_table_.add(e.prototype->name, *e.prototype, type_manager_);
             return true;
         }, 
         [&](FunctionNode& f) -> bool {
-            if (f.prototype->name == "__anon_expr") {
-                auto ret = f.body.data.front().get();
-                auto ret_cast = dynamic_cast<ReturnExpr*>(ret);
-                auto command = ret_cast->ret.get();
-                if (f.prototype->answer != "uninit") {
-                    if (check(command, f.prototype->answer)) {
-                        let_all_literal_typed(command, f.prototype->answer);
-                        return true;
-                    } else {
-                        return false;
-                    }
+            if (f.prototype->name == Symbols::anon_expr) {
+                auto ret = expr_cast<ReturnExpr>(f.body.data.front());
+                auto command = ret->ret;
+                TypeId answer = any;
+                if (f.prototype->answer != uninit_type) {
+                    answer = type_id_of(f.prototype->answer);
                 }
 
-                anonymous_binary_type_str_ = "any";
-                anonymous_binary_status_ = AgainstStatus::Init;
-                if (!check_anonymous_expression(command)) {
+                if (!check_standalone(command, answer)) {
                     err_ += "execution body type check error;";
                     return false;
-                    if (!check_anonymous_expression(command)) {
-                        err_ += "execution body type check error;";
-                        return false;
-                    }
                 }
-                if (anonymous_binary_type_str_ == "any") {
+                if (answer == any) {
                     err_ += "cannot infer execution result type;";
                     return false;                    
                 }
-                f.prototype->answer = anonymous_binary_type_str_;
-                let_all_literal_typed(command, f.prototype->answer);
-                anonymous_binary_status_ = AgainstStatus::Init;
+                f.prototype->answer = Symbol(type_name(answer));
                 return true;
             }
-            std::vector<std::string> types {};
-            types.push_back(f.prototype->answer);
-            for (auto& arg: f.prototype->args) {
-                types.push_back(arg.second);
-                symbol_table_.add_symbol(arg.first, arg.second);
+
+            function_table_.add(f.prototype->name, *f.prototype, type_manager_);
+            auto signature = function_table_.find(f.prototype->name);
+            for (size_t i = 0; i < f.prototype->args.size(); i++) {
+                symbol_table_.bind(f.prototype->args[i].first, signature[i + 1]);
             }
-            function_table_[f.prototype->name] = types;
+            result_type_ = signature[0];
 
-            auto result_type = f.prototype->answer;
-            result_type_ = result_type;
-            return check(f.body, result_type);
+            return check(f.body, result_type_);
         },
         [&](StructNode& s) -> bool {
             return true;
@@ -103,284 +80,207 @@ bool TypeChecker::check(ASTNode& node) {
     );
 }
 
-bool TypeChecker::check(const Body& body, std::string& type) {
+bool TypeChecker::check(const Body& body, TypeId type) {
     auto n = body.data.size();
     auto limit = (body.has_return_value) ? n - 1 : n;
-    for (int iter = 0; iter < limit; iter++) {
-        auto expr = body.data[iter].get();
-        bool valid = false;
-        std::string my_any = "any";
-        auto l = dynamic_cast<LiteralExpr*>(expr);
-        if (l) {
-            valid = check(l, my_any); 
-        }
-
-        auto c = dynamic_cast<CallExpr*>(expr);
-        if (c) {
-            valid = check(c, my_any);
-        }
-        
-        auto v = dynamic_cast<VariableExpr*>(expr);
-        if (v) {
-            valid = check(v, my_any);
-        }
-        
-        auto b = dynamic_cast<BinaryExpr*>(expr);
-        if (b) {
-            valid = check(b, my_any);
-        }
-
-        auto i = dynamic_cast<IfExpr*>(expr);
-        if (i) {
-            valid = check(i, my_any);
-        }
-
-        auto f = dynamic_cast<ForExpr*>(expr);
-        if (f) {
-            valid = check(f, my_any);
-        }
-
-        auto u = dynamic_cast<UnaryExpr*>(expr);
-        if (u) {
-            valid = check(u, my_any);
-        }
-
-        auto var = dynamic_cast<VarDeclareExpr*>(expr);
-        if (var) {
-            valid = check(var, my_any);
-        }
-
-        auto r = dynamic_cast<ReturnExpr*>(expr);
-        if (r) {
-            valid = check(r, result_type_);
-        }
-
-        auto arr = dynamic_cast<ArrayExpr*>(expr);
-        if (arr) {
-            valid = check(arr, my_any);
-        }
-
-        if (!valid) {
-            //err_ += "no expression find.";
+    for (size_t iter = 0; iter < limit; iter++) {
+        TypeId statement_type = any;
+        if (!check_standalone(body.data[iter], statement_type)) {
             return false;
         }
     }
     if (body.has_return_value) {
-        auto expr = body.data.back().get();
-        bool valid = false;
-        auto l = dynamic_cast<LiteralExpr*>(expr);
-        if (l) {
-            valid = check(l, type); 
-        }
-
-        auto c = dynamic_cast<CallExpr*>(expr);
-        if (c) {
-            valid = check(c, type);
-        }
-        
-        auto v = dynamic_cast<VariableExpr*>(expr);
-        if (v) {
-            valid = check(v, type);
-        }
-        
-        auto b = dynamic_cast<BinaryExpr*>(expr);
-        if (b) {
-            valid = check(b, type);
-        }
-
-        auto i = dynamic_cast<IfExpr*>(expr);
-        if (i) {
-            valid = check(i, type);
-        }
-
-        auto f = dynamic_cast<ForExpr*>(expr);
-        if (f) {
-            assert(false && "Shouldn't goto end-line for-expr\n");
-        }
-
-        auto u = dynamic_cast<UnaryExpr*>(expr);
-        if (u) {
-            valid = check(u, type);
-        }
-
-        auto var = dynamic_cast<VarDeclareExpr*>(expr);
-        if (var) {
-            static std::string tmp_void = "void";
-            valid = TypeSystem::is_same_type(type, tmp_void);
-        }
-
-        auto r = dynamic_cast<ReturnExpr*>(expr);
-        if (r) {
-            valid = check(r, result_type_);
-        }
-
-        auto arr = dynamic_cast<ArrayExpr*>(expr);
-        if (arr) {
-            valid = check(arr, result_type_);
-        }
+        size_t from = untyped_literals_.size();
+        bool valid = visit_expression(body.data.back(), overloaded{
+            [&](ForExpr*) -> bool {
+                assert(false && "Shouldn't goto end-line for-expr\n");
+                return false;
+            },
+            [&](VarDeclareExpr* v) -> bool {
+                // a declaration has no value, it only ends a body whose value nobody uses
+                return type == any && check(v, type);
+            },
+            [&](ReturnExpr* r) -> bool {
+                TypeId result_type = result_type_;
+                return check(r, result_type);
+            },
+            [&](ArrayExpr* arr) -> bool {
+                TypeId result_type = result_type_;
+                return check(arr, result_type);
+            },
+            [&](auto* node) -> bool { return check(node, type); },
+        });
 
         if (!valid) {
-            //err_ += "body-return type check error";
             return false;
         }
+        if (type != any) {
+            settle_literals(from, type);
+        }
     }
     return true;
 }
 
-bool TypeChecker::check(Expression* expr, std::string& type) {
-    auto l = dynamic_cast<LiteralExpr*>(expr);
-    if (l) {
-        return check(l, type);
+bool TypeChecker::check_standalone(Expression* expr, TypeId& type, TypeId fallback) {
+    size_t from = untyped_literals_.size();
+    if (!check(expr, type)) {
+        return false;
     }
-
-    auto c = dynamic_cast<CallExpr*>(expr);
-    if (c) {
-        return check(c, type);
+    if (untyped_literals_.size() == from) {
+        return true;
     }
-    
-    auto v = dynamic_cast<VariableExpr*>(expr);
-    if (v) {
-        return check(v, type);
+
+    if (type == any) {
+        type = fallback;
     }
-    
-    auto b = dynamic_cast<BinaryExpr*>(expr);
-    if (b) {
-        return check(b, type);
+    if (type == any) {
+        err_ += "cannot infer literal type;";
+        return false;
     }
+    settle_literals(from, type);
+    return true;
+}
 
-    auto i = dynamic_cast<IfExpr*>(expr);
-    if (i) {
-        return check(i, type);
+void TypeChecker::settle_literals(size_t from, TypeId type) {
+    for (size_t i = from; i < untyped_literals_.size(); i++) {
+        untyped_literals_[i]->type_id = type;
     }
+    untyped_literals_.resize(from);
+}
 
-    auto f = dynamic_cast<ForExpr*>(expr);
-    if (f) {
-        return check(f, type);
+bool TypeChecker::check(Expression* expr, TypeId& type) {
+    if (!expr) {
+        err_ += "no expression find;";
+        return false;
     }
 
-    auto u = dynamic_cast<UnaryExpr*>(expr);
-    if (u) {
-        return check(u, type);
-    }
+    return visit_expression(expr, overloaded{
+        [&](ReturnExpr* r) -> bool {
+            TypeId result_type = result_type_;
+            return check(r, result_type);
+        },
+        [&](auto* node) -> bool { return check(node, type); },
+    });
+}
 
-    auto var = dynamic_cast<VarDeclareExpr*>(expr);
-    if (var) {
-        return check(var, type);
-    }
+bool TypeChecker::check(LiteralExpr* expr, TypeId& type) {
+    static const Symbol uninit_type("uninit");
 
-    auto r = dynamic_cast<ReturnExpr*>(expr);
-    if (r) {
-        return check(r, result_type_);
+    if (expr->type == uninit_type) {
+        if (type == any) {
+            untyped_literals_.push_back(expr);
+        } else {
+            expr->type_id = type;
+        }
+        return true; 
     }
 
-    auto arr = dynamic_cast<ArrayExpr*>(expr);
-    if (arr) {
-        return check(arr, type);
+    auto literal_type = type_id_of(expr->type);
+    if (!TypeSystem::is_same_type(literal_type, type)) {
+        err_ += "Literal check error;";
+        err_ += "found " + type_name(literal_type);
+        err_ += " expect " + type_name(type) + ';';
+        return false;
     }
-
-    err_ += "no expression find;";
-    return false;
+    expr->type_id = literal_type;
+    if (type == any) {
+        type = literal_type;
+    }
+    return true;
 }
 
-bool TypeChecker::check(LiteralExpr* expr, std::string& type) {
-    if (anonymous_binary_status_ == AgainstStatus::Checked) {
-        expr->type = anonymous_binary_type_str_;
-        // std::cout << "Literal " << expr->value << " type is " << TypeSystem::get_type_str(expr->type) << std::endl;
-        return true;
-    }
-    
-    if (expr->type == "uninit") {
-        expr->type = type;
-        // std::cout << "Literal " << expr->value << " type is " << TypeSystem::get_type_str(expr->type) << std::endl;
-        return true; 
-    } else {
-        if (!TypeSystem::is_same_type(expr->type, type)) {
-            err_ += "Literal check error;";
-            err_ += "found " + expr->type;
-            err_ += " expect " + type + ';';
-            return false;
+bool TypeChecker::check_access(VariableExpr* expr, TypeId& type) {
+    for (auto& addr: expr->addrs) {
+        auto base = type_manager_.get(type);
+        if (std::holds_alternative<ExpressionPtr>(addr)) {
+            if (!base->is_data_structure()) {
+                err_ += "offset into " + type_name(type) + " which is not an array;";
+                return false;
+            }
+            TypeId offset_type = i32;
+            if (!check(std::get<ExpressionPtr>(addr), offset_type)) {
+                err_ += "array offset type check error;";
+                return false;
+            }
+            type = static_cast<TypeSystem::ArrayType*>(base)->element_type->id;
         } else {
-            // std::cout << "Literal " << expr->value << " type is " << TypeSystem::get_type_str(expr->type) << std::endl;
-            return true;
+            auto& field = std::get<VariableExpr::Field>(addr);
+            auto struct_type = base->is_aggregate() ? static_cast<TypeSystem::AggregateType*>(base) : nullptr;
+            auto element_type = struct_type ? struct_type->element_type(field.name) : nullptr;
+            if (!element_type) {
+                err_ += type_name(type) + " has no member " + std::string(field.name.str()) + ';';
+                return false;
+            }
+            field.index = struct_type->element_position(field.name);
+            type = element_type->id;
         }
     }
+    return true;
 }
 
-bool TypeChecker::check(VariableExpr* expr, std::string& type) {
-    auto _type = symbol_table_.find_symbol_type(expr->name);
-
-    if (!expr->addrs.empty()) {
-        for (auto& addr: expr->addrs) {
-            if (std::holds_alternative<ExpressionPtr>(addr)) {
-                _type = TypeSystem::extract_nesting_type(_type).first;
-            } else {
-                auto& taked_element = std::get<std::string>(addr);
-                auto struct_type = type_manager_.find_type_by_name(_type);
-                auto struct_type_raw = static_cast<TypeSystem::AggregateType*>(struct_type.get());
-                _type = struct_type_raw->element_type(taked_element)->name();
-            }
-        }
+bool TypeChecker::check(VariableExpr* expr, TypeId& type) {
+    auto bound = symbol_table_.find(expr->name);
+    if (!bound) {
+        err_ += "unknown variable " + std::string(expr->name.str()) + ';';
+        return false;
+    }
+    auto _type = *bound;
+    if (!check_access(expr, _type)) {
+        return false;
     }
 
-    if (TypeSystem::is_same_type(_type, type)) {
-        if (anonymous_binary_status_ == AgainstStatus::Checking) {
-            if (anonymous_binary_type_str_ == "any") {
-                anonymous_binary_type_str_ = _type;
-            }
-        }
-        return true;
-    } else {
+    if (!TypeSystem::is_same_type(_type, type)) {
         err_ += "variable type check error;";
-        err_ += "target: " + expr->name + " found " + symbol_table_.find_symbol_type(expr->name);
-        err_ += " expect " + type + ';';
-
+        err_ += "target: " + std::string(expr->name.str()) + " found " + type_name(_type);
+        err_ += " expect " + type_name(type) + ';';
         return false;
     }
+    if (type == any) {
+        type = _type;
+    }
+    return true;
 }
 
-bool TypeChecker::check(BinaryExpr* expr, std::string& type) {
-    if (expr->oper == "=") {
-        auto _type = type;
-        auto lhs = expr->lhs.get();
-        auto variable = static_cast<VariableExpr*>(lhs);
-        if (!variable) {
+bool TypeChecker::check(BinaryExpr* expr, TypeId& type) {
+    if (expr->oper == Symbols::assign) {
+        if (!expr->lhs || expr->lhs->kind != ExprKind::Variable) {
             err_ += "lhs should be variable;";
             return false;
-        } else {
-            _type = symbol_table_.find_symbol_type(variable->name);
-            if (!variable->addrs.empty()) {
-                for (auto& addr: variable->addrs) {
-                    if (std::holds_alternative<ExpressionPtr>(addr)) {
-                        auto& taked_offset = std::get<ExpressionPtr>(addr);
-                        let_all_literal_typed(taked_offset.get(), my_int32);
-                        _type = TypeSystem::extract_nesting_type(_type).first;
-                    } else {
-                        auto& taked_element = std::get<std::string>(addr);                        
-                        auto struct_type = type_manager_.find_type_by_name(_type);
-                        auto struct_type_raw = static_cast<TypeSystem::AggregateType*>(struct_type.get());
-                        _type = struct_type_raw->element_type(taked_element)->name();                       
-                    }
-                }
-            }
+        }
+        auto variable = static_cast<VariableExpr*>(expr->lhs);
+        auto bound = symbol_table_.find(variable->name);
+        if (!bound) {
+            err_ += "unknown variable " + std::string(variable->name.str()) + ';';
+            return false;
+        }
+        auto _type = *bound;
+        if (!check_access(variable, _type)) {
+            return false;
         }
 
         if (!expr->rhs) {
             err_ += "no rhs;";
             return false;
         }
-        if (check(expr->rhs.get(), _type)) {
-            let_all_literal_typed(expr->rhs.get(), _type);
-            return true;
+        if (!check(expr->rhs, _type)) {
+            return false;
         }
-        return false;
+        if (type == any) {
+            type = _type;
+        }
+        return true;
     }
 
-    if (!(expr->lhs && check(expr->lhs.get(), type))) {
+    if (expr->oper == Symbols::less) {
+        return check_comparison(expr, type);
+    }
+
+    if (!(expr->lhs && check(expr->lhs, type))) {
         err_ += "lhs type check error;";
         return false;
     }
 
-    if (!(expr->rhs && check(expr->rhs.get(), type))) {
+    if (!(expr->rhs && check(expr->rhs, type))) {
         err_ += "rhs type check error;";
         return false;
     }
@@ -388,38 +288,110 @@ bool TypeChecker::check(BinaryExpr* expr, std::string& type) {
     return true;
 }
 
-bool TypeChecker::check(CallExpr* expr, std::string& type) {
-    auto& target_function = function_table_[expr->callee];
+bool TypeChecker::check_comparison(BinaryExpr* expr, TypeId& type) {
+    if (!TypeSystem::is_same_type(boolean, type)) {
+        err_ += "comparison gives bool but " + type_name(type) + " expected;";
+        return false;
+    }
+
+    // both sides share a number type of their own, literals alone on both sides are doubles
+    size_t from = untyped_literals_.size();
+    TypeId operand_type = any;
+    if (!(expr->lhs && check(expr->lhs, operand_type))) {
+        err_ += "lhs type check error;";
+        return false;
+    }
+    if (!(expr->rhs && check(expr->rhs, operand_type))) {
+        err_ += "rhs type check error;";
+        return false;
+    }
+    if (operand_type == any) {
+        operand_type = f64;
+    }
+    if (operand_type != i32 && operand_type != f64) {
+        err_ += "cannot compare " + type_name(operand_type) + ';';
+        return false;
+    }
+    settle_literals(from, operand_type);
+
+    if (type == any) {
+        type = boolean;
+    }
+    return true;
+}
+
+bool TypeChecker::check(CallExpr* expr, TypeId& type) {
+    auto target_function = function_table_.find(expr->callee);
+    if (target_function.empty()) {
+        if (auto target = conversion_target(expr->callee); target != error && expr->args.size() == 1) {
+            return check_conversion(expr, target, type);
+        }
+        err_ += "unknown function " + std::string(expr->callee.str()) + ';';
+        return false;
+    }
     if (target_function.size() - 1 != expr->args.size()) {
         err_ += "function args size not match, expect " + std::to_string(target_function.size() - 1) + " but " + std::to_string(expr->args.size()) + ';';
         return false;
     }
-    auto iter = target_function.begin();
-    if (!TypeSystem::is_same_type(*iter, type)) {
+    if (!TypeSystem::is_same_type(target_function[0], type)) {
         err_ += "function return type check error;";
         return false;
     }
-    
-    if (anonymous_binary_status_ == AgainstStatus::Checking) {
-        if (anonymous_binary_type_str_ == "any") {
-            anonymous_binary_type_str_ = *iter;
-        }
+    if (type == any) {
+        type = target_function[0];
     }
 
-    iter++;
+    size_t index = 1;
     for (auto& arg: expr->args) {
-        if (!check(arg.get(), *iter)) {
-            iter++;
+        TypeId arg_type = target_function[index++];
+        if (!check(arg, arg_type)) {
             err_ += "function arg type check error;";
             return false;
         }
     }
+    return true;
+}
 
-    let_all_literal_typed(expr);
+TypeId TypeChecker::conversion_target(Symbol callee) {
+    static const Symbol bool_name("bool");
+    static const Symbol i32_name("i32");
+    static const Symbol double_name("double");
+    if (callee == bool_name) return boolean;
+    if (callee == i32_name) return i32;
+    if (callee == double_name) return f64;
+    return error;
+}
+
+bool TypeChecker::check_conversion(CallExpr* expr, TypeId target, TypeId& type) {
+    if (!TypeSystem::is_same_type(target, type)) {
+        err_ += "conversion to " + type_name(target) + " but " + type_name(type) + " expected;";
+        return false;
+    }
+
+    TypeId value_type = any;
+    if (!check_standalone(expr->args[0], value_type, f64)) {
+        err_ += "conversion value type check error;";
+        return false;
+    }
+    if (value_type != i32 && value_type != f64 && value_type != boolean) {
+        err_ += "cannot convert " + type_name(value_type) + " to " + type_name(target) + ';';
+        return false;
+    }
+
+    expr->conversion = target;
+    if (type == any) {
+        type = target;
+    }
     return true;
 }
 
-bool TypeChecker::check(IfExpr* expr, std::string& type) {
+bool TypeChecker::check(IfExpr* expr, TypeId& type) {
+    TypeId condition_type = boolean;
+    if (!check_standalone(expr->condition, condition_type)) {
+        err_ += "condition body type check error;";
+        return false;
+    }
+
     if (!check(expr->then, type)) {
         err_ += "then body type check error;";
         return false;        
@@ -430,43 +402,59 @@ bool TypeChecker::check(IfExpr* expr, std::string& type) {
         return false; 
     }
 
-/*     if (!check(expr->condition.get(), TypeSystem::Type::Any)) {
-        err_ += "condition type check error;";
-        return false;
-    } */
-    anonymous_binary_type_str_ = "any";
-    anonymous_binary_status_ = AgainstStatus::Init;
-    
-    if (!check_anonymous_expression(expr->condition.get())) {
-        err_ += "condition body type check error;";
-        return false;
-    } else {
-        if (!check_anonymous_expression(expr->condition.get())) {
-            err_ += "condition body type check-against error;";
-            return false;
-        } 
-    }
-    anonymous_binary_status_ = AgainstStatus::Init;
-
     return true;
 }
 
-bool TypeChecker::check(ForExpr* expr, std::string& type) {
-    if (!check(expr->body, type)) {
+bool TypeChecker::check(ForExpr* expr, TypeId& type) {
+    // the loop variable takes the type of its start, an unannotated literal keeps it a double
+    TypeId var_type = any;
+    if (!check_standalone(expr->start, var_type, f64)) {
+        err_ += "loop start type check error;";
+        return false;
+    }
+    if (var_type != i32 && var_type != f64) {
+        err_ += "loop variable should be i32 or double but " + type_name(var_type) + ';';
+        return false;
+    }
+    expr->type_id = var_type;
+
+    symbol_table_.step();
+    symbol_table_.bind(expr->var_name, var_type);
+
+    TypeId end_type = boolean;
+    TypeId step_type = var_type;
+    bool valid = true;
+    if (!check_standalone(expr->end, end_type)) {
+        err_ += "loop condition type check error;";
+        valid = false;
+    } else if (expr->step && !check_standalone(expr->step, step_type)) {
+        err_ += "loop step type check error;";
+        valid = false;
+    } else if (!check(expr->body, type)) {
         err_ += "loop body type check error;";
-        return false;        
+        valid = false;
     }
-    return true;
+
+    symbol_table_.back();
+    return valid;
 }
 
-bool TypeChecker::check(UnaryExpr* expr, std::string& type) {
-    auto& args = function_table_[expr->_operater];
+bool TypeChecker::check(UnaryExpr* expr, TypeId& type) {
+    auto args = function_table_.find(expr->_operater);
+    if (args.size() != 2) {
+        err_ += "unknown unary operator " + std::string(expr->_operater.str()) + ';';
+        return false;
+    }
     if (!TypeSystem::is_same_type(args[0], type)) {
         err_ += "unary return type check error;";
         return false;        
     }
+    if (type == any) {
+        type = args[0];
+    }
 
-    if (!TypeSystem::is_same_type(args[1], type)) {
+    TypeId operand_type = args[1];
+    if (!check(expr->operand, operand_type)) {
         err_ += "unary operand type check error;";
         return false;        
     }
@@ -474,123 +462,50 @@ bool TypeChecker::check(UnaryExpr* expr, std::string& type) {
     return true;
 }
 
-bool TypeChecker::check(VarDeclareExpr* expr, std::string& type) {
-    symbol_table_.add_symbol(expr->name, expr->type);
-    let_all_literal_typed(expr->value.get(), expr->type);
-    return true;
-}
-
-bool TypeChecker::check(ReturnExpr* expr, std::string& type) {
-    if (!check(expr->ret.get(), type)) {
-        err_ += "return type check error;";
-        return false;        
-    }
-    let_all_literal_typed(expr->ret.get(), type);
-    return true;
-}
-
-bool TypeChecker::check(ArrayExpr* expr, std::string& type) {
-    for (auto& element: expr->elements) {
-        if (!check(element.get(), type)) {
+bool TypeChecker::check(VarDeclareExpr* expr, TypeId& type) {
+    expr->type_id = type_id_of(expr->type);
+    if (expr->value) {
+        TypeId value_type = expr->type_id;
+        if (!check(expr->value, value_type)) {
+            err_ += "initializer of " + std::string(expr->name.str()) + " type check error;";
             return false;
         }
     }
+    symbol_table_.bind(expr->name, expr->type_id);
     return true;
 }
 
-bool TypeChecker::check_anonymous_expression(Expression* expr) {
-    switch (anonymous_binary_status_) {
-    case AgainstStatus::Init:
-        anonymous_binary_status_ = AgainstStatus::Checking;
-        break;
-    case AgainstStatus::Checking:
-        anonymous_binary_status_ = AgainstStatus::Checked;
-        break;
-    case AgainstStatus::Checked:
-        break;
-    }
-    static std::string my_any = "any";
-
-    auto l = dynamic_cast<LiteralExpr*>(expr);
-    if (l) {
-        return true;
-    }
-
-    auto c = dynamic_cast<CallExpr*>(expr);
-    if (c) {
-        return check(c, my_any);
-    }
-    
-    auto v = dynamic_cast<VariableExpr*>(expr);
-    if (v) {
-        return true;
-    }
-    
-    auto b = dynamic_cast<BinaryExpr*>(expr);
-    if (b) {
-        return check(b, my_any);
-    }
-
-    auto u = dynamic_cast<UnaryExpr*>(expr);
-    if (u) {
-        return check(u, my_any);
+bool TypeChecker::check(ReturnExpr* expr, TypeId& type) {
+    if (!check(expr->ret, type)) {
+        err_ += "return type check error;";
+        return false;        
     }
-
-    err_ = "anonymous expression check error;";
-    return false;
+    return true;
 }
 
-void TypeChecker::let_all_literal_typed(Expression* expr, std::string& type) {
-    auto l = dynamic_cast<LiteralExpr*>(expr);
-    if (l) {
-        l->type = type;
-        return;
-    }
-        
-    auto b = dynamic_cast<BinaryExpr*>(expr);
-    if (b) {
-        let_all_literal_typed(b->lhs.get(), type);
-        let_all_literal_typed(b->rhs.get(), type);
-    }
-
-    auto u = dynamic_cast<UnaryExpr*>(expr);
-    if (u) {
-        let_all_literal_typed(u->operand.get(), type);
+bool TypeChecker::check(ArrayExpr* expr, TypeId& type) {
+    // the parser spells the type from the innermost element, an expected type knows the nesting
+    TypeId array_type = (type == any) ? type_id_of(expr->type) : type;
+    auto base = type_manager_.get(array_type);
+    if (!base->is_data_structure()) {
+        err_ += "array found where " + type_name(array_type) + " expected;";
+        return false;
     }
-
-    auto c = dynamic_cast<CallExpr*>(expr);
-    if (c) {
-        let_all_literal_typed(c);
+    auto array = static_cast<TypeSystem::ArrayType*>(base);
+    if (static_cast<size_t>(array->length) != expr->elements.size()) {
+        err_ += "array of " + std::to_string(expr->elements.size()) + " elements found where " + type_name(array_type) + " expected;";
+        return false;
     }
 
-    auto arr = dynamic_cast<ArrayExpr*>(expr);
-    if (arr) {
-        auto [element_type, array_size] = TypeSystem::extract_nesting_type(type);
-        for (auto& element: arr->elements) {
-            let_all_literal_typed(element.get(), element_type);
+    for (auto& element: expr->elements) {
+        TypeId element_type = array->element_type->id;
+        if (!check(element, element_type)) {
+            return false;
         }
     }
-
-    auto v = dynamic_cast<VariableExpr*>(expr);
-    if (v) {
-        if (!v->addrs.empty()) {
-            for (auto& offset: v->addrs) {
-                if (std::holds_alternative<ExpressionPtr>(offset)) {
-                    auto& taked_offset = std::get<ExpressionPtr>(offset);
-                    let_all_literal_typed(taked_offset.get(), my_int32);
-                }
-            }
-        }
+    expr->type_id = array_type;
+    if (type == any) {
+        type = array_type;
     }
-
-    return;    
+    return true;
 }
-
-void TypeChecker::let_all_literal_typed(CallExpr* expr) {
-    auto& args_type = function_table_[expr->callee];
-    int iter = 1;
-    for (auto& arg: expr->args) {
-        let_all_literal_typed(arg.get(), args_type[iter]);
-        iter++;
-    }
-}
\ No newline at end of file
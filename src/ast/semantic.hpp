@@ -1,67 +1,75 @@
 #pragma once
 
 #include "ast.hpp"
+#include "ast/scoped_table.hpp"
 #include "ast/type.hpp"
+#include <cstdint>
+#include <span>
 #include <unordered_map>
 #include <vector>
 
 namespace Semantic {
 
-class NaiveSymbolTable {
+/// SignatureTable keeps the result and argument types of every function back to back in one pool.
+class SignatureTable {
 public:
-    NaiveSymbolTable() {
-        table_ = {{}};
-    }
-
-    void add_symbol(std::string& name, std::string& type);
-    std::string& find_symbol_type(std::string& name);
-    void step();
-    void back();
-    void clear();
-
-    using Segment = std::unordered_map<std::string, std::string>;
+    void add(Symbol name, const ProtoType& proto, TypeManager& type_manager);
+    // result type first, then the arguments; empty for an unknown function
+    [[nodiscard]] std::span<const TypeId> find(Symbol name) const;
 private:
-    std::vector<Segment> table_;
-    std::string my_error_ = "error";
+    struct Signature {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    std::unordered_map<Symbol, Signature> signatures_;
+    std::vector<TypeId> types_;
 };
 
 }  // namespace Semantic
 
+/// TypeChecker resolves the types of an item in one walk and records them on the nodes,
+/// together with struct member positions, so codegen never looks a type up by name.
 class TypeChecker {
 public:
     explicit TypeChecker(TypeManager& type_manager): type_manager_(type_manager) {}
 
     bool check(ASTNode& a);
-    bool check(const Body& body, std::string& type);
-    bool check(Expression* expr, std::string& type);
-    bool check(LiteralExpr* expr, std::string& type);
-    bool check(VariableExpr* expr, std::string& type);
-    bool check(BinaryExpr* expr, std::string& type);
-    bool check(CallExpr* expr, std::string& type);
-    bool check(IfExpr* expr, std::string& type);
-    bool check(ForExpr* expr, std::string& type);
-    bool check(UnaryExpr* expr, std::string& type);
-    bool check(VarDeclareExpr* expr, std::string& type);
-    bool check(ReturnExpr* expr, std::string& type);
-    bool check(ArrayExpr* expr, std::string& type);
-
-    // check against
-    bool check_anonymous_expression(Expression* expr);
-    void let_all_literal_typed(Expression* expr, std::string& type);
-    void let_all_literal_typed(CallExpr* expr);
+    bool check(const Body& body, TypeId type);
+    // type is the expected one, when it is any the type found is written back to it
+    bool check(Expression* expr, TypeId& type);
+    bool check(LiteralExpr* expr, TypeId& type);
+    bool check(VariableExpr* expr, TypeId& type);
+    bool check(BinaryExpr* expr, TypeId& type);
+    bool check(CallExpr* expr, TypeId& type);
+    bool check(IfExpr* expr, TypeId& type);
+    bool check(ForExpr* expr, TypeId& type);
+    bool check(UnaryExpr* expr, TypeId& type);
+    bool check(VarDeclareExpr* expr, TypeId& type);
+    bool check(ReturnExpr* expr, TypeId& type);
+    bool check(ArrayExpr* expr, TypeId& type);
 public:
     std::string err_;
 private:
-    enum class AgainstStatus {Init, Checking, Checked};
-    AgainstStatus anonymous_binary_status_;
-    std::string anonymous_binary_type_str_;
-
-    Semantic::NaiveSymbolTable symbol_table_;
-    std::unordered_map<std::string, std::vector<std::string>> function_table_;
-    std::string result_type_;
+    // checks an expression whose value nobody expects a type for, like a statement or a condition,
+    // literals nothing else types get the fallback
+    bool check_standalone(Expression* expr, TypeId& type, TypeId fallback = TypeSystem::BuiltinTypes::any);
+    void settle_literals(size_t from, TypeId type);
+    // '<' takes two numbers of one type and gives a bool
+    bool check_comparison(BinaryExpr* expr, TypeId& type);
+    // "bool(x)", "i32(x)" and "double(x)" convert between the primitive types unless a function takes the name
+    TypeId conversion_target(Symbol callee);
+    bool check_conversion(CallExpr* expr, TypeId target, TypeId& type);
+    // walks the offsets and members of a variable, type goes from the variable's to the accessed one
+    bool check_access(VariableExpr* expr, TypeId& type);
+    TypeId type_id_of(Symbol name) { return type_manager_.find_type_by_name(name)->id; }
+    const std::string& type_name(TypeId id) { return type_manager_.get(id)->name(); }
 
-    std::string my_int32 = "i32";
+    ScopedTable<TypeId> symbol_table_; // the type of each variable in scope
+    Semantic::SignatureTable function_table_;
+    TypeId result_type_ = TypeSystem::BuiltinTypes::any;
+    // literals met while the expected type was still any, typed once check_standalone knows it
+    std::vector<LiteralExpr*> untyped_literals_;
 
     TypeManager& type_manager_;
 };
-
@@ -0,0 +1,49 @@
+#include "source.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::unique_ptr<SourceBuffer> SourceBuffer::open(const std::string& path, std::string& err) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        err = std::strerror(errno);
+        return nullptr;
+    }
+
+    struct stat status {};
+    if (fstat(fd, &status) != 0) {
+        err = std::strerror(errno);
+        close(fd);
+        return nullptr;
+    }
+
+    auto size = static_cast<size_t>(status.st_size);
+    if (size == 0) {
+        close(fd);
+        return std::unique_ptr<SourceBuffer>(new SourceBuffer(nullptr, 0));
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive on its own
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        err = std::strerror(errno);
+        return nullptr;
+    }
+
+    // the lexer reads front to back exactly once, let the kernel read ahead for it; advice values
+    // are not flags, so one call each. Both are hints, a refusal changes nothing but speed
+    (void)madvise(mapped, size, MADV_SEQUENTIAL);
+    (void)madvise(mapped, size, MADV_WILLNEED);
+    return std::unique_ptr<SourceBuffer>(new SourceBuffer(static_cast<const char*>(mapped), size));
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
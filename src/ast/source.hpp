@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/// SourceBuffer maps a whole input file read-only into memory. Lexers and tokens
+/// refer to spans of view() directly, so the input is never copied.
+class SourceBuffer {
+public:
+    static std::unique_ptr<SourceBuffer> open(const std::string& path, std::string& err);
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    ~SourceBuffer();
+
+    [[nodiscard]] std::string_view view() const { return {data_, size_}; }
+private:
+    SourceBuffer(const char* data, size_t size): data_(data), size_(size) {}
+
+    const char* data_;
+    size_t size_;
+};
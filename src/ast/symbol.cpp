@@ -0,0 +1,79 @@
+#include "symbol.hpp"
+
+#include <bit>
+#include <cassert>
+
+namespace {
+
+// the chunk of an id and its position there, chunk k starts at first_chunk * (2^k - 1)
+std::pair<size_t, size_t> locate(SymbolId id, size_t first_chunk) {
+    size_t chunk = std::bit_width(id / first_chunk + 1) - 1;
+    return {chunk, id - first_chunk * ((size_t(1) << chunk) - 1)};
+}
+
+}  // namespace
+
+Interner& Interner::session() {
+    static Interner interner;
+    return interner;
+}
+
+Interner::Interner() {
+    // id 0 is the empty spelling, so a default constructed Symbol is always valid
+    intern("");
+}
+
+Interner::~Interner() {
+    for (auto& chunk: chunks_) {
+        delete[] chunk.load();
+    }
+}
+
+SymbolId Interner::intern(std::string_view text) {
+    auto hash = std::hash<std::string_view>{}(text);
+    // the high bits, the low ones pick the bucket inside the shard
+    auto& shard = shards_[(hash >> 32) % shard_count];
+    {
+        std::shared_lock lock(shard.mutex);
+        auto iter = shard.ids.find(text);
+        if (iter != shard.ids.end()) {
+            return iter->second;
+        }
+    }
+
+    std::unique_lock lock(shard.mutex);
+    auto iter = shard.ids.find(text);
+    if (iter != shard.ids.end()) {
+        return iter->second;
+    }
+    auto id = next_id_.fetch_add(1);
+    std::string_view stored = shard.storage.emplace_back(text);
+    // written before the id is published in the map, whoever holds the id may read it
+    slot(id) = stored;
+    shard.ids.emplace(stored, id);
+    return id;
+}
+
+std::string_view& Interner::slot(SymbolId id) {
+    auto [chunk, index] = locate(id, first_chunk);
+    auto names = chunks_[chunk].load(std::memory_order_acquire);
+    if (!names) {
+        std::lock_guard lock(grow_mutex_);
+        names = chunks_[chunk].load(std::memory_order_relaxed);
+        if (!names) {
+            names = new std::string_view[first_chunk << chunk];
+            chunks_[chunk].store(names, std::memory_order_release);
+        }
+    }
+    return names[index];
+}
+
+std::string_view Interner::name(SymbolId id) const {
+    assert(id < next_id_.load() && "unknown symbol id");
+    auto [chunk, index] = locate(id, first_chunk);
+    return chunks_[chunk].load(std::memory_order_acquire)[index];
+}
+
+size_t Interner::size() const {
+    return next_id_.load();
+}
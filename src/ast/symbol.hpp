@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using SymbolId = uint32_t;
+
+/// Interner keeps one copy of every identifier and operator spelling of a session,
+/// addressed by a dense 32-bit id. Lookups from several parsing threads are allowed: the
+/// spellings are spread over shards with a lock each, and names are read without any lock.
+class Interner {
+public:
+    static Interner& session();
+
+    SymbolId intern(std::string_view text);
+    std::string_view name(SymbolId id) const;
+    size_t size() const;
+private:
+    Interner();
+    ~Interner();
+
+    struct Shard {
+        std::shared_mutex mutex;
+        std::deque<std::string> storage; // deque never moves its strings, so the views stay valid
+        std::unordered_map<std::string_view, SymbolId> ids;
+    };
+    static constexpr size_t shard_count = 16;
+
+    // names by id live in chunks which never move, chunk k holds first_chunk << k of them
+    static constexpr size_t first_chunk = 1024;
+    static constexpr size_t max_chunks = 23; // enough for every 32-bit id
+    std::string_view& slot(SymbolId id);
+
+    std::array<Shard, shard_count> shards_;
+    std::array<std::atomic<std::string_view*>, max_chunks> chunks_ {};
+    std::mutex grow_mutex_;
+    std::atomic<SymbolId> next_id_ = 0;
+};
+
+/// Symbol is a handle of an interned spelling, comparing or hashing it never touches the text.
+struct Symbol {
+    SymbolId id = 0;
+
+    Symbol() = default;
+    explicit Symbol(std::string_view text): id(Interner::session().intern(text)) {}
+    static Symbol from_id(SymbolId id) {
+        Symbol symbol;
+        symbol.id = id;
+        return symbol;
+    }
+
+    [[nodiscard]] std::string_view str() const { return Interner::session().name(id); }
+    [[nodiscard]] bool empty() const { return id == 0; }
+
+    friend bool operator==(Symbol a, Symbol b) { return a.id == b.id; }
+    friend bool operator!=(Symbol a, Symbol b) { return a.id != b.id; }
+    friend bool operator<(Symbol a, Symbol b) { return a.id < b.id; }
+
+    friend std::ostream& operator<<(std::ostream& os, Symbol s) {
+        return os << s.str();
+    }
+};
+
+template<>
+struct std::hash<Symbol> {
+    size_t operator()(Symbol s) const noexcept { return s.id; }
+};
+
+// spellings which the compiler itself compares against
+namespace Symbols {
+
+inline const Symbol anon_expr {"__anon_expr"};
+inline const Symbol assign {"="};
+inline const Symbol less {"<"};
+inline const Symbol true_literal {"true"};
+inline const Symbol false_literal {"false"};
+
+}  // namespace Symbols
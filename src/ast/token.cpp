@@ -1,21 +1,25 @@
 #include "token.hpp"
 
-std::string Token::get_string() const {
+Symbol Token::get_symbol() const {
     assert(
         this->type_ == TokenType::Identifier
         || this->type_ == TokenType::Operator);
 
-    return std::any_cast<std::string>(this->value_);
+    return Symbol::from_id(value_.symbol);
+}
+
+std::string_view Token::get_string() const {
+    return get_symbol().str();
 }
 
 double Token::get_literal() const {
     assert(this->type_ == TokenType::Literal);
 
-    return std::any_cast<double>(this->value_);
+    return value_.literal;
 }
 
 bool Token::is_const() const {
     assert(this->type_ == TokenType::Var);
 
-    return std::any_cast<bool>(this->value_);
+    return value_.is_const;
 }
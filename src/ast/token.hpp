@@ -1,13 +1,15 @@
 #pragma once
 
-#include <string>
-#include <any>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <memory>
+#include <string_view>
 #include <vector>
 
-enum class TokenType {
+#include "symbol.hpp"
+
+enum class TokenType: uint8_t {
     Eof,
     Def, 
     Extern, 
@@ -38,18 +40,30 @@ enum class TokenType {
     Init
 };
 
+/// Token is packed into 16 bytes: the payload, the source span and the kind.
+/// Identifiers and operators carry an interned Symbol, literals are stored inline.
 class Token {
 public:
-    Token(TokenType t, std::string v): type_(t), value_(v) {}
-    Token(TokenType t, double v): type_(t), value_(v) {}
-    Token(TokenType t, bool c): type_(t), value_(c) {}
+    Token(TokenType t, Symbol s): type_(t) { value_.symbol = s.id; }
+    Token(TokenType t, double v): type_(t) { value_.literal = v; }
+    Token(TokenType t, bool c): type_(t) { value_.is_const = c; }
     explicit Token(TokenType t): type_(t) {}
     Token() = default;
 
-    [[nodiscard]] std::string get_string() const;
+    [[nodiscard]] Symbol get_symbol() const;
+    [[nodiscard]] std::string_view get_string() const;
     [[nodiscard]] double get_literal() const;
     [[nodiscard]] bool is_const() const;
 
+    void set_span(uint32_t offset, uint32_t length) {
+        offset_ = offset;
+        length_ = length;
+    }
+    // the spelling of this token inside the source it was lexed from
+    [[nodiscard]] std::string_view text(std::string_view source) const {
+        return source.substr(offset_, length_);
+    }
+
     friend std::ostream& operator<<(std::ostream& os, const Token& t) {
         switch (t.type_) {
         case TokenType::Eof:
@@ -114,9 +128,19 @@ public:
         return os;
     }
 
-    TokenType type_ = TokenType::Init;
-    std::any value_;
+private:
+    union {
+        SymbolId symbol;
+        double literal;
+        bool is_const;
+    } value_ {};
+public:
+    uint32_t offset_ = 0; // span in the lexed source
+    uint32_t length_ : 24 = 0;
+    TokenType type_ : 8 = TokenType::Init;
 };
 
+static_assert(sizeof(Token) == 16, "Token should stay packed");
+
 using TokenPtr = std::unique_ptr<Token>;
 using TokenPtrVec = std::vector<TokenPtr>;
\ No newline at end of file
@@ -20,6 +20,14 @@
 
 namespace TypeSystem {
 
+llvm::Type* TypeBase::llvm_type(llvm::LLVMContext& context) {
+    if (cached_context_ != &context) {
+        cached_type_ = make_llvm_type(context);
+        cached_context_ = &context;
+    }
+    return cached_type_;
+}
+
 uint64_t PrimitiveType::llvm_memory_size(llvm::Module& _module) {
     if (memory_size_) {
         return memory_size_;
@@ -37,7 +45,7 @@ llvm::Value* Int32Type::llvm_init_value(llvm::LLVMContext& context) {
     return llvm::ConstantInt::get(context, llvm::APInt(32, 0));
 }
 
-llvm::Type* Int32Type::llvm_type(llvm::LLVMContext& context) {
+llvm::Type* Int32Type::make_llvm_type(llvm::LLVMContext& context) {
     return llvm::Type::getInt32Ty(context);
 }
 
@@ -50,7 +58,7 @@ llvm::Value* DoubleType::llvm_init_value(llvm::LLVMContext& context) {
     return llvm::ConstantFP::get(context, llvm::APFloat(0.0));
 }
 
-llvm::Type* DoubleType::llvm_type(llvm::LLVMContext& context) {
+llvm::Type* DoubleType::make_llvm_type(llvm::LLVMContext& context) {
     return llvm::Type::getDoubleTy(context);
 }
 
@@ -59,7 +67,20 @@ llvm::Value* DoubleType::get_llvm_value(llvm::LLVMContext& context, std::any val
     return llvm::ConstantFP::get(context, llvm::APFloat(taked));
 }
 
-llvm::Type* VoidType::llvm_type(llvm::LLVMContext& context) {
+llvm::Value* BoolType::llvm_init_value(llvm::LLVMContext& context) {
+    return llvm::ConstantInt::getFalse(context);
+}
+
+llvm::Type* BoolType::make_llvm_type(llvm::LLVMContext& context) {
+    return llvm::Type::getInt1Ty(context);
+}
+
+llvm::Value* BoolType::get_llvm_value(llvm::LLVMContext& context, std::any value) {
+    auto taked = std::any_cast<double>(value);
+    return llvm::ConstantInt::getBool(context, taked != 0);
+}
+
+llvm::Type* VoidType::make_llvm_type(llvm::LLVMContext& context) {
     return llvm::Type::getVoidTy(context);
 }
 
@@ -72,7 +93,7 @@ llvm::Value* ArrayType::llvm_init_value(llvm::LLVMContext& context) {
     return llvm::ConstantArray::get(casted_type, casted_value);
 }
 
-llvm::Type* ArrayType::llvm_type(llvm::LLVMContext& context) {
+llvm::Type* ArrayType::make_llvm_type(llvm::LLVMContext& context) {
     return llvm::ArrayType::get(this->element_type->llvm_type(context), length);
 }
 
@@ -107,8 +128,8 @@ uint64_t ArrayType::llvm_memory_size(llvm::Module& _module) {
     }
 }
  */
-AggregateType::AggregateType(std::string name, std::vector<std::pair<std::string, std::string>>& elements, TypeManager& manager)
-    : name_(std::move(name)) {
+AggregateType::AggregateType(std::string name, std::vector<std::pair<Symbol, std::string>>& elements, TypeManager& manager)
+    : TypeBase(std::move(name)) {
     int posi = 0;
     for (auto& [_name, type_str]: elements) {
         auto type = manager.find_type_by_name(type_str);
@@ -119,8 +140,8 @@ AggregateType::AggregateType(std::string name, std::vector<std::pair<std::string
     }
 
     for (auto& [index, type_ptr]: index_with_types_) {
-        name_type_hash_.insert({position_name_[index], type_ptr.get()});
-        index_type_hash_.insert({index, type_ptr.get()});
+        name_type_hash_.insert({position_name_[index], type_ptr});
+        index_type_hash_.insert({index, type_ptr});
     }
 }
 
@@ -135,13 +156,18 @@ llvm::Value* AggregateType::llvm_init_value(llvm::LLVMContext& context) {
     return llvm::ConstantStruct::get(casted_type, values);
 }
 
-llvm::Type* AggregateType::llvm_type(llvm::LLVMContext& context) {
+llvm::Type* AggregateType::make_llvm_type(llvm::LLVMContext& context) {
     std::vector<llvm::Type*> types;
     types.reserve(index_with_types_.size());
     for (auto& [_, type]: index_with_types_) {
         types.push_back(type->llvm_type(context));
     }
-    return llvm::StructType::create(context, types, name_);
+    // a context may outlive the cache, as the pooled one of the jit does, so its struct is reused
+    if (auto existing = llvm::StructType::getTypeByName(context, name());
+        existing && existing->elements() == llvm::ArrayRef<llvm::Type*>(types)) {
+        return existing;
+    }
+    return llvm::StructType::create(context, types, name());
 }
 
 llvm::Value* AggregateType::get_llvm_value(llvm::LLVMContext& context, std::any value) {
@@ -159,11 +185,11 @@ uint64_t AggregateType::llvm_memory_size(llvm::Module& _module) {
     return len;
 }
 
-unsigned int AggregateType::element_position(std::string& element) {
+unsigned int AggregateType::element_position(Symbol element) {
     return name_position_[element];
 }
 
-TypeBase* AggregateType::element_type(std::string& element) {
+TypeBase* AggregateType::element_type(Symbol element) {
     return name_type_hash_[element];
 }
 
@@ -175,10 +201,7 @@ bool is_same_type(TypeBase* a, TypeBase* b) {
         assert(false && "rhs is empty");
     }
 
-    if (a->name() == "any" || b->name() == "any") {
-        return true;
-    } 
-    return a->name() == b->name();
+    return is_same_type(a->id, b->id);
 }
 
 bool is_same_type(std::string& str, TypeBase* t) {
@@ -198,7 +221,7 @@ bool is_same_type(std::string& str, std::string& name) {
     return str == name;
 }
 
-std::pair<std::string, int> extract_nesting_type(std::string& name) {
+std::pair<std::string, int> extract_nesting_type(const std::string& name) {
     if (name == "any") {
         return {"any", -1};
     }
@@ -221,27 +244,81 @@ std::pair<std::string, int> extract_nesting_type(std::string& name) {
 }  // namespace TypeSystem
 
 TypeManager::TypeManager() {
-    type_table_.insert({"i32", std::make_unique<TypeSystem::Int32Type>()});
-    type_table_.insert({"double", std::make_unique<TypeSystem::DoubleType>()});
-    type_table_.insert({"error", std::make_unique<TypeSystem::ErrorType>()});
-    type_table_.insert({"uninit", std::make_unique<TypeSystem::UninitType>()});
-    type_table_.insert({"any", std::make_unique<TypeSystem::AnyType>()});
+    insert(std::make_unique<TypeSystem::Int32Type>());
+    insert(std::make_unique<TypeSystem::DoubleType>());
+    insert(std::make_unique<TypeSystem::ErrorType>());
+    insert(std::make_unique<TypeSystem::UninitType>());
+    insert(std::make_unique<TypeSystem::AnyType>());
+    insert(std::make_unique<TypeSystem::BoolType>());
+    assert(types_[TypeSystem::BuiltinTypes::boolean]->name() == "bool" && "builtin types out of order");
 }
 
-std::shared_ptr<TypeSystem::TypeBase> TypeManager::find_type_by_name(std::string& name) {
-    if (type_table_.count(name)) {
-        return type_table_[name]->shared_from_this();
+TypeId TypeManager::insert(std::unique_ptr<TypeSystem::TypeBase> type) {
+    auto id = static_cast<TypeId>(types_.size());
+    type->id = id;
+    ids_by_name_.emplace(type->name(), id);
+    types_.push_back(std::move(type));
+    return id;
+}
+
+TypeId TypeManager::array_of(TypeId element, int length) {
+    uint64_t key = (static_cast<uint64_t>(element) << 32) | static_cast<uint32_t>(length);
+    auto iter = array_ids_.find(key);
+    if (iter != array_ids_.end()) {
+        return iter->second;
+    }
+    auto id = insert(std::make_unique<TypeSystem::ArrayType>(length, types_[element].get()));
+    array_ids_.emplace(key, id);
+    return id;
+}
+
+TypeSystem::TypeBase* TypeManager::find_type_by_name(const std::string& name) {
+    auto iter = ids_by_name_.find(name);
+    if (iter != ids_by_name_.end()) {
+        return types_[iter->second].get();
     } else if (name.starts_with("array")) {
+        // first use of this array type, its spelling is parsed once and then remembered
         auto [element_name, array_size] = TypeSystem::extract_nesting_type(name);
-        auto type_ptr = find_type_by_name(element_name);
-        type_table_.insert({name, std::make_shared<TypeSystem::ArrayType>(array_size, std::move(type_ptr))});
-        return type_table_[name]->shared_from_this();        
+        auto element = find_type_by_name(element_name);
+        auto id = array_of(element->id, array_size);
+        ids_by_name_.emplace(name, id);
+        return types_[id].get();
     } else {
         std::cout << "type name is: " << name << std::endl;
         assert(false && "Unknown type name");        
     }
 }
 
-void TypeManager::add_type(std::string& name, std::vector<std::pair<std::string, std::string>>& _elements){
-    type_table_.insert({name, std::make_shared<TypeSystem::AggregateType>(name, _elements, *this)});
-}
\ No newline at end of file
+void TypeManager::add_type(std::string& name, std::vector<std::pair<Symbol, std::string>>& _elements){
+    if (ids_by_name_.count(name)) {
+        return;
+    }
+    insert(std::make_unique<TypeSystem::AggregateType>(name, _elements, *this));
+}
+
+TypeSystem::TypeBase* TypeManager::find_type_by_name(Symbol name) {
+    auto iter = ids_by_symbol_.find(name);
+    if (iter != ids_by_symbol_.end()) {
+        return types_[iter->second].get();
+    }
+    auto type = find_type_by_name(std::string(name.str()));
+    ids_by_symbol_.emplace(name, type->id);
+    return type;
+}
+
+void TypeManager::add_type(Symbol name, std::span<const std::pair<Symbol, Symbol>> elements) {
+    std::string str(name.str());
+    std::vector<std::pair<Symbol, std::string>> typed_elements;
+    typed_elements.reserve(elements.size());
+    for (auto& [element, type]: elements) {
+        typed_elements.emplace_back(element, type.str());
+    }
+    add_type(str, typed_elements);
+}
+
+void TypeManager::forget_llvm_types() {
+    // a new context may reuse the address of a destroyed one, so the cache can't be keyed by it alone
+    for (auto& type: types_) {
+        type->forget_llvm_type();
+    }
+}
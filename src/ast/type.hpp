@@ -2,6 +2,7 @@
 
 #include <any>
 #include <cassert>
+#include <cstdint>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Type.h>
@@ -9,19 +10,28 @@
 #include <llvm/ADT/APFloat.h>
 #include <llvm/IR/Constant.h>
 #include <memory>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "symbol.hpp"
+#include "type_id.hpp"
+
 class TypeManager;
 
 namespace TypeSystem {
 
-struct TypeBase: public std::enable_shared_from_this<TypeBase> {
-    virtual std::string name() = 0;
+struct TypeBase {
+    virtual ~TypeBase() = default;
+
+    [[nodiscard]] const std::string& name() const { return name_; }
+    // built once per context, the TypeManager drops the cache when the context changes
+    llvm::Type* llvm_type(llvm::LLVMContext& context);
+    void forget_llvm_type() { cached_context_ = nullptr; cached_type_ = nullptr; }
+
     virtual llvm::Value* llvm_init_value(llvm::LLVMContext& context) = 0;
-    virtual llvm::Type* llvm_type(llvm::LLVMContext& context) = 0;
     virtual llvm::Value* get_llvm_value(llvm::LLVMContext& context, std::any value) = 0;
 
     virtual bool is_primitive() = 0;
@@ -29,6 +39,15 @@ struct TypeBase: public std::enable_shared_from_this<TypeBase> {
     virtual bool is_data_structure() = 0;
 
     virtual uint64_t llvm_memory_size(llvm::Module& _module) = 0;
+
+    TypeId id = 0; // set by the TypeManager which owns the type
+protected:
+    explicit TypeBase(std::string name): name_(std::move(name)) {}
+    virtual llvm::Type* make_llvm_type(llvm::LLVMContext& context) = 0;
+private:
+    std::string name_;
+    llvm::LLVMContext* cached_context_ = nullptr;
+    llvm::Type* cached_type_ = nullptr;
 };
 
 struct PrimitiveType: public TypeBase {
@@ -36,6 +55,8 @@ struct PrimitiveType: public TypeBase {
     bool is_aggregate() final {return false;}
     bool is_data_structure() final {return false;}
     uint64_t llvm_memory_size(llvm::Module& _module) override;
+protected:
+    using TypeBase::TypeBase;
 private:
     uint64_t memory_size_ = 0;
 };
@@ -45,25 +66,24 @@ struct AggregateType: public TypeBase {
     bool is_aggregate() final {return true;}
     bool is_data_structure() final {return false;}
     
-    AggregateType(std::string name, std::vector<std::pair<std::string, std::string>>& elements, TypeManager& manager);
+    AggregateType(std::string name, std::vector<std::pair<Symbol, std::string>>& elements, TypeManager& manager);
 
     llvm::Value* llvm_init_value(llvm::LLVMContext& context) override;
-    llvm::Type* llvm_type(llvm::LLVMContext& context) override;
     llvm::Value* get_llvm_value(llvm::LLVMContext& context, std::any value) override;    
     uint64_t llvm_memory_size(llvm::Module& _module) override;
     
-    std::string name() override {return name_;}
-    unsigned int element_position(std::string& element);
+    unsigned int element_position(Symbol element);
     TypeBase* element_type(unsigned int index);
-    TypeBase* element_type(std::string& element);
+    TypeBase* element_type(Symbol element);
 
-    std::string name_;
-    std::vector<std::pair<std::string, std::string>> elements_;
+    std::vector<std::pair<Symbol, std::string>> elements_;
+protected:
+    llvm::Type* make_llvm_type(llvm::LLVMContext& context) override;
 private:
-    std::vector<std::pair<unsigned int, std::shared_ptr<TypeBase>>> index_with_types_{};
-    std::unordered_map<unsigned int, std::string> position_name_{};
-    std::unordered_map<std::string, unsigned int> name_position_{};
-    std::unordered_map<std::string, TypeBase*> name_type_hash_{};
+    std::vector<std::pair<unsigned int, TypeBase*>> index_with_types_{};
+    std::unordered_map<unsigned int, Symbol> position_name_{};
+    std::unordered_map<Symbol, unsigned int> name_position_{};
+    std::unordered_map<Symbol, TypeBase*> name_type_hash_{};
     std::unordered_map<unsigned int, TypeBase*> index_type_hash_{};
 
 };
@@ -72,111 +92,121 @@ struct DataStructureType: public TypeBase {
     bool is_primitive() final {return false;}
     bool is_aggregate() final {return false;}
     bool is_data_structure() final {return true;}  
+protected:
+    using TypeBase::TypeBase;
 };
 
 struct LogicalType: public TypeBase {
     bool is_primitive() final {return false;}
     bool is_aggregate() final {return false;}
     bool is_data_structure() final {return false;}   
+protected:
+    using TypeBase::TypeBase;
+    llvm::Type* make_llvm_type(llvm::LLVMContext& context) override {assert(false && "logical type have no llvm type");}
 };
 
 struct Int32Type: public PrimitiveType {
-    std::string name() override {
-        static std::string name = "i32";
-        return name;
-    }
+    Int32Type(): PrimitiveType("i32") {}
     llvm::Value* llvm_init_value(llvm::LLVMContext& context) override;
-    llvm::Type* llvm_type(llvm::LLVMContext& context) override;
     llvm::Value* get_llvm_value(llvm::LLVMContext& context, std::any value) override;
+protected:
+    llvm::Type* make_llvm_type(llvm::LLVMContext& context) override;
 };
 
 struct DoubleType: public PrimitiveType {
-    std::string name() override {
-        static std::string name = "double";
-        return name;
-    }
+    DoubleType(): PrimitiveType("double") {}
+    llvm::Value* llvm_init_value(llvm::LLVMContext& context) override;
+    llvm::Value* get_llvm_value(llvm::LLVMContext& context, std::any value) override;
+protected:
+    llvm::Type* make_llvm_type(llvm::LLVMContext& context) override;
+};
+
+struct BoolType: public PrimitiveType {
+    BoolType(): PrimitiveType("bool") {}
     llvm::Value* llvm_init_value(llvm::LLVMContext& context) override;
-    llvm::Type* llvm_type(llvm::LLVMContext& context) override;
     llvm::Value* get_llvm_value(llvm::LLVMContext& context, std::any value) override;
+protected:
+    llvm::Type* make_llvm_type(llvm::LLVMContext& context) override;
 };
 
 struct VoidType: public PrimitiveType {
-    std::string name() override {
-        static std::string name = "void";
-        return name;
-    }
+    VoidType(): PrimitiveType("void") {}
     llvm::Value* llvm_init_value(llvm::LLVMContext& context) override {return nullptr;}
-    llvm::Type* llvm_type(llvm::LLVMContext& context) override;
     llvm::Value* get_llvm_value(llvm::LLVMContext& context, std::any value) override {return nullptr;}
     uint64_t llvm_memory_size(llvm::Module& _module) override;
+protected:
+    llvm::Type* make_llvm_type(llvm::LLVMContext& context) override;
 };
 
 struct ArrayType: public DataStructureType {
-    std::string name() override {
-        std::string name = "array%";
-        std::string ans = name + element_type->name() + '%' + std::to_string(length);
-        return ans;
-    }
     llvm::Value* llvm_init_value(llvm::LLVMContext& context) override;
-    llvm::Type* llvm_type(llvm::LLVMContext& context) override;
     llvm::Value* get_llvm_value(llvm::LLVMContext& context, std::any value) override;
     uint64_t llvm_memory_size(llvm::Module& _module) override;
 
-    ArrayType(int len, std::shared_ptr<TypeBase> type): element_type(std::move(type)), length(len) {} 
+    ArrayType(int len, TypeBase* type)
+        : DataStructureType("array%" + type->name() + '%' + std::to_string(len)), element_type(type), length(len) {} 
 
-    std::shared_ptr<TypeBase> element_type;
+    TypeBase* element_type;
     int length = 0;
+protected:
+    llvm::Type* make_llvm_type(llvm::LLVMContext& context) override;
 };
 
 struct AnyType: public LogicalType {
-    std::string name() override {
-        static std::string name = "any";
-        return name;
-    };
+    AnyType(): LogicalType("any") {}
     llvm::Value* llvm_init_value(llvm::LLVMContext& context) override {assert(false && "any type have no init valye");}
-    llvm::Type* llvm_type(llvm::LLVMContext& context) override {assert(false && "any type have no llvm type");}
     llvm::Value* get_llvm_value(llvm::LLVMContext& context, std::any value) override {assert(false && "any type have no concrete value");}      
     uint64_t llvm_memory_size(llvm::Module& _module) override {assert(false && "any type have no memory size");};
 }; 
 
 struct UninitType: public LogicalType {
-    std::string name() override {
-        static std::string name = "uninit";
-        return name;
-    };
+    UninitType(): LogicalType("uninit") {}
     llvm::Value* llvm_init_value(llvm::LLVMContext& context) override {assert(false && "uninit type have no init valye");}
-    llvm::Type* llvm_type(llvm::LLVMContext& context) override {assert(false && "uninit type have no llvm type");}
     llvm::Value* get_llvm_value(llvm::LLVMContext& context, std::any value) override {assert(false && "uninit type have no concrete value");}  
     uint64_t llvm_memory_size(llvm::Module& _module) override {assert(false && "any type have no memory size");};
 }; 
 
 struct ErrorType: public LogicalType {
-    std::string name() override {
-        static std::string name = "error";
-        return name;
-    };
+    ErrorType(): LogicalType("error") {}
     llvm::Value* llvm_init_value(llvm::LLVMContext& context) override {assert(false && "error type have no init valye");}
-    llvm::Type* llvm_type(llvm::LLVMContext& context) override {assert(false && "error type have no llvm type");}
     llvm::Value* get_llvm_value(llvm::LLVMContext& context, std::any value) override {assert(false && "error type have no concrete value");}  
     uint64_t llvm_memory_size(llvm::Module& _module) override {assert(false && "any type have no memory size");};
 }; 
 
+// types of one TypeManager are the same when their ids are, any matches everything
+inline bool is_same_type(TypeId a, TypeId b) {
+    return a == b || a == BuiltinTypes::any || b == BuiltinTypes::any;
+}
 bool is_same_type(TypeBase* a, TypeBase* b);
 bool is_same_type(std::string& str, TypeBase* t);
 bool is_same_type(std::string& str, std::string& name);
 
-std::pair<std::string, int> extract_nesting_type(std::string& name);
+std::pair<std::string, int> extract_nesting_type(const std::string& name);
  
 }  // namespace TypeSystem
 
-using TypePtr = std::shared_ptr<TypeSystem::TypeBase>;
+using TypePtr = TypeSystem::TypeBase*;
 using TypedInstanceName = std::pair<std::string, TypePtr>;
 
+/// TypeManager owns every type of a session once. Arrays are hash-consed by element
+/// and length, so equal types are one object and compare by TypeId.
 class TypeManager {
 public:
     TypeManager();
-    std::shared_ptr<TypeSystem::TypeBase> find_type_by_name(std::string& name);
-    void add_type(std::string& name, std::vector<std::pair<std::string, std::string>>& _elements);
+    TypeSystem::TypeBase* find_type_by_name(const std::string& name);
+    TypeSystem::TypeBase* find_type_by_name(Symbol name);
+    [[nodiscard]] TypeSystem::TypeBase* get(TypeId id) const { return types_[id].get(); }
+    TypeId array_of(TypeId element, int length);
+    void add_type(std::string& name, std::vector<std::pair<Symbol, std::string>>& _elements);
+    void add_type(Symbol name, std::span<const std::pair<Symbol, Symbol>> elements);
+
+    // drops the llvm types cached for the previous context, call it whenever the context is replaced
+    void forget_llvm_types();
 private:
-    std::unordered_map<std::string, std::shared_ptr<TypeSystem::TypeBase>> type_table_;
+    TypeId insert(std::unique_ptr<TypeSystem::TypeBase> type);
+
+    std::vector<std::unique_ptr<TypeSystem::TypeBase>> types_;
+    std::unordered_map<std::string, TypeId> ids_by_name_;  // every spelling met, nested array ones too
+    std::unordered_map<Symbol, TypeId> ids_by_symbol_;
+    std::unordered_map<uint64_t, TypeId> array_ids_;       // (element id, length) -> array id
 };
\ No newline at end of file
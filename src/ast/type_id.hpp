@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+/// TypeId addresses a type of one TypeManager, structurally equal types share the id.
+using TypeId = uint32_t;
+
+namespace TypeSystem {
+
+// the types every TypeManager starts with, in this order
+namespace BuiltinTypes {
+
+constexpr TypeId i32 = 0;
+constexpr TypeId f64 = 1;
+constexpr TypeId error = 2;
+constexpr TypeId uninit = 3;
+constexpr TypeId any = 4;
+constexpr TypeId boolean = 5;
+
+}  // namespace BuiltinTypes
+
+}  // namespace TypeSystem
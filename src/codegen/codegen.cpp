@@ -7,15 +7,12 @@
 #include <llvm/ADT/Optional.h>
 #include <llvm/Support/CodeGen.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetOptions.h>
 #include <llvm-c/TargetMachine.h>
 #include <llvm/MC/TargetRegistry.h>
-#include <llvm/Transforms/Utils.h>
-#include <llvm/Transforms/Scalar.h>
-#include <llvm/Transforms/Scalar/GVN.h>
 #include <llvm/IR/LegacyPassManager.h>
-#include <llvm/Transforms/InstCombine/InstCombine.h>
 #include <llvm/ADT/APFloat.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
@@ -47,32 +44,11 @@
 #include "codegen/jit_engine.hpp"
 
 void CodeGenerator::print(std::string&& file_addr) {
-    LLVMInitializeAllTargetInfos();
-    LLVMInitializeAllTargets();
-    LLVMInitializeAllTargetMCs();
-    LLVMInitializeAllAsmParsers();
-    LLVMInitializeAllAsmPrinters();
-
-    auto target_triple = LLVMGetDefaultTargetTriple();
-    module_->setTargetTriple(target_triple);
-
-    std::string target_error;
-    auto target = llvm::TargetRegistry::lookupTarget(target_triple, target_error);
-    if (!target) {
-        output_stream_ << target_error << '\n';
+    if (!target_machine_) {
+        output_stream_ << "no target machine for " << module_->getTargetTriple() << '\n';
         exit(1);
     }
-
-    auto cpu = "generic";
-    auto features = "";
-
-    llvm::TargetOptions opt;
-    auto rm = llvm::Optional<llvm::Reloc::Model>();
-
-    auto target_machine = target->createTargetMachine(
-        target_triple, cpu, features, opt, rm);
-
-    module_->setDataLayout(target_machine->createDataLayout());
+    optimizer_->run(*module_);
 
     std::error_code ec;
     llvm::raw_fd_ostream dest(file_addr, ec, llvm::sys::fs::OF_None);
@@ -85,7 +61,7 @@ void CodeGenerator::print(std::string&& file_addr) {
     llvm::legacy::PassManager pass;
     auto file_type = llvm::CGFT_ObjectFile;
 
-    if (target_machine->addPassesToEmitFile(pass, dest, nullptr, file_type)) {
+    if (target_machine_->addPassesToEmitFile(pass, dest, nullptr, file_type)) {
         output_stream_ << "TargetMachine can't emit a file of this type\n";
         exit(1);
     }
@@ -99,44 +75,63 @@ void CodeGenerator::print(std::string&& file_addr) {
 CodeGenerator::CodeGenerator(llvm::raw_ostream& os, CodeGeneratorSetting setting, bool init): output_stream_(os) {
     setting_.function_pass_optimize = setting.function_pass_optimize;
     setting_.print_ir = setting.print_ir;
+    setting_.opt_level = setting.opt_level;
+    setting_.target = setting.target;
+    setting_.lazy_compile = setting.lazy_compile;
+    setting_.tiered_compile = setting.tiered_compile;
+    setting_.hot_call_threshold = setting.hot_call_threshold;
+    setting_.compile_threads = setting.compile_threads;
+    setting_.object_cache = setting.object_cache;
+    setting_.batch_execs = setting.batch_execs;
+    setting_.exec_cache_size = setting.exec_cache_size;
+    setting_.exec_mode = setting.exec_mode;
     
     if (init) {
-        context_ = std::make_unique<llvm::LLVMContext>();
+        LLVMInitializeAllTargetInfos();
+        LLVMInitializeAllTargets();
+        LLVMInitializeAllTargetMCs();
+        LLVMInitializeAllAsmParsers();
+        LLVMInitializeAllAsmPrinters();
+
+        context_owner_ = llvm::orc::ThreadSafeContext(std::make_unique<llvm::LLVMContext>());
+        context_ = context_owner_.getContext();
         module_ = std::make_unique<llvm::Module>("my cool compiler", *context_);
 
-        builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);    
-        if (setting_.function_pass_optimize) {
-            function_pass_manager_ = std::make_unique<llvm::legacy::FunctionPassManager>(module_.get());
-
-            function_pass_manager_->add(llvm::createPromoteMemoryToRegisterPass());
-            function_pass_manager_->add(llvm::createInstructionCombiningPass());
-            function_pass_manager_->add(llvm::createReassociatePass());
-            // function_pass_manager_->add(llvm::createGVNPass());
-            function_pass_manager_->add(llvm::createCFGSimplificationPass());
-        
-            function_pass_manager_->doInitialization();
+        // the module knows its target from the start, so the optimizer tunes for the same cpu print() emits for
+        auto target_triple = llvm::sys::getDefaultTargetTriple();
+        module_->setTargetTriple(target_triple);
+        std::string target_error;
+        target_machine_ = create_target_machine(
+            target_triple, setting_.target, codegen_opt_level(setting_.opt_level), target_error);
+        if (target_machine_) {
+            module_->setDataLayout(target_machine_->createDataLayout());
+        } else {
+            output_stream_ << target_error << '\n';
         }
+
+        builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);    
+        optimizer_ = std::make_unique<Optimizer>(setting_.opt_level, target_machine_.get());
     }
 }
 
 llvm::AllocaInst* CodeGenerator::create_entry_block_alloca(
-    llvm::Function* function, const std::string& var_name, TypeSystem::TypeBase* type) {
+    llvm::Function* function, llvm::StringRef var_name, TypeSystem::TypeBase* type) {
     llvm::IRBuilder<> builder(&function->getEntryBlock(), function->getEntryBlock().begin());
     auto llvm_type = type->llvm_type(*context_);
     return builder.CreateAlloca(llvm_type, nullptr, var_name);
 }
 
 llvm::AllocaInst* CodeGenerator::create_entry_block_alloca(llvm::Function* function,
-                                                const std::string& var_name, llvm::Type* llvm_type) {
+                                                llvm::StringRef var_name, llvm::Type* llvm_type) {
     llvm::IRBuilder<> builder(&function->getEntryBlock(), function->getEntryBlock().begin());
     return builder.CreateAlloca(llvm_type, nullptr, var_name);
 }
 
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<ArrayExpr> e) {
+llvm::Value* CodeGenerator::codegen(const ArrayExpr& e) {
     std::vector<llvm::Constant*> values;
     int cnt = 0;
-    for (auto& element: e->elements) {
-        auto element_value = codegen(std::move(element));
+    for (auto& element: e.elements) {
+        auto element_value = codegen(element);
         if (!element_value) {
             err_ = "generate array value idx: " + std::to_string(cnt) + " error";
             return nullptr;
@@ -144,7 +139,7 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<ArrayExpr> e) {
         values.push_back(static_cast<llvm::Constant*>(element_value));
         cnt++;
     }
-    auto array_type = type_manager_.find_type_by_name(e->type);
+    auto array_type = type_manager_.get(e.type_id);
     auto ans = array_type->get_llvm_value(*context_, std::any(values));
     if (!ans) {
         err_ = "Generate ConstantArray error";
@@ -153,8 +148,8 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<ArrayExpr> e) {
     return ans;
 }
 
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<ReturnExpr> e) {
-    llvm::Value* ret = codegen(std::move(e->ret));
+llvm::Value* CodeGenerator::codegen(const ReturnExpr& e) {
+    llvm::Value* ret = codegen(e.ret);
     if (!err_.empty()) {
         return nullptr;
     }
@@ -167,19 +162,16 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<ReturnExpr> e) {
     return nullptr;
 } 
 
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<VarDeclareExpr> e) {
-    std::vector<llvm::AllocaInst*> old_bindings_{};
+llvm::Value* CodeGenerator::codegen(const VarDeclareExpr& e) {
     llvm::Function* function = builder_->GetInsertBlock()->getParent();
 
-    symbol_table_.step();
-
-    auto& var_name = e->name;
-    auto var_type = type_manager_.find_type_by_name(e->type);
-    auto init = std::move(e->value);
+    auto var_name = e.name;
+    auto var_type = type_manager_.get(e.type_id);
+    auto init = e.value;
 
     llvm::Value* init_value = nullptr;
     if (init) {
-        init_value = codegen(std::move(init));
+        init_value = codegen(init);
         if (!err_.empty()) {
             return nullptr;
         }
@@ -187,19 +179,16 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<VarDeclareExpr> e) {
         init_value = var_type->llvm_init_value(*context_);
     }
 
-    if (e->is_const) {
+    if (e.is_const) {
         if (!init_value) {
             output_stream_ << "error in store const\n";
         }
-        if (var_type->is_aggregate() || var_type->is_data_structure()) {
-            symbol_table_.add_constant(var_name, init_value, var_type->name());
-        }
         symbol_table_.add_constant(var_name, init_value);
     } else {
         llvm::AllocaInst* alloca = nullptr;
         if (var_type->is_data_structure()) {            
-            auto array_type = static_cast<TypeSystem::ArrayType*>(var_type.get());
-            alloca = create_entry_block_alloca(function, var_name, array_type);
+            auto array_type = static_cast<TypeSystem::ArrayType*>(var_type);
+            alloca = create_entry_block_alloca(function, var_name.str(), array_type);
             
             auto shadow_global_array = new llvm::GlobalVariable(
                 *module_, array_type->llvm_type(*context_), true,
@@ -219,30 +208,30 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<VarDeclareExpr> e) {
                 array_type->llvm_memory_size(*module_)
             );
 
-            symbol_table_.add_variant(var_name, alloca, var_type->name());
+            symbol_table_.add_variant(var_name, alloca, true);
         } else if (var_type->is_primitive()) {
-            alloca = create_entry_block_alloca(function, var_name, var_type.get());
+            alloca = create_entry_block_alloca(function, var_name.str(), var_type);
             builder_->CreateStore(init_value, alloca);
             symbol_table_.add_variant(var_name, alloca);
         } else if (var_type->is_aggregate()) {
-            auto struct_type = static_cast<TypeSystem::AggregateType*>(var_type.get());
-            alloca = create_entry_block_alloca(function, var_name, struct_type);
+            auto struct_type = static_cast<TypeSystem::AggregateType*>(var_type);
+            alloca = create_entry_block_alloca(function, var_name.str(), struct_type);
 
-            symbol_table_.add_variant(var_name, alloca, var_type->name());            
+            symbol_table_.add_variant(var_name, alloca, true);            
         }
     }
 
     return nullptr;
 }
 
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<UnaryExpr> e) {
-    llvm::Value* opnd_value = codegen(std::move(e->operand));
+llvm::Value* CodeGenerator::codegen(const UnaryExpr& e) {
+    llvm::Value* opnd_value = codegen(e.operand);
     if (!opnd_value) {
         return nullptr;
     }
 
-    if (!e->_operater.empty()) {
-        llvm::Function* f = get_function(e->_operater);
+    if (!e._operater.empty()) {
+        llvm::Function* f = get_function(e._operater);
         if (!f) {
             err_ = "Unknown unary operator";
             return nullptr;
@@ -267,12 +256,14 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<UnaryExpr> e) {
 //   endcond = endexpr
 //   br endcond, loop, endloop
 // outloop:
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<ForExpr> e) {
+llvm::Value* CodeGenerator::codegen(const ForExpr& e) {
     llvm::Function* function = builder_->GetInsertBlock()->getParent();
-    auto double_type = std::make_unique<TypeSystem::DoubleType>();
-    llvm::AllocaInst* alloca = create_entry_block_alloca(function, e->var_name, double_type.get());
+    // an integer loop variable gives the canonical induction variable the loop passes look for
+    llvm::Type* var_type = type_manager_.get(e.type_id)->llvm_type(*context_);
+    bool is_integer = var_type->isIntegerTy();
+    llvm::AllocaInst* alloca = create_entry_block_alloca(function, e.var_name.str(), var_type);
 
-    auto start_value = codegen(std::move(e->start));
+    auto start_value = codegen(e.start);
     if (!start_value) {
         return nullptr;
     }
@@ -285,46 +276,47 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<ForExpr> e) {
     builder_->SetInsertPoint(loop_block);
     
     // Start the PHI node with an entry for Start.
-    // llvm::PHINode* phi = builder_->CreatePHI(llvm::Type::getDoubleTy(*context_), 2, e->var_name);
+    // llvm::PHINode* phi = builder_->CreatePHI(llvm::Type::getDoubleTy(*context_), 2, e.var_name);
     // phi->addIncoming(start_value, pre_header_block);
 
     // Within the loop, the variable is defined equal to the PHI node.  If it
     // shadows an existing variable, we have to restore it, so save it now.
     symbol_table_.step();
-    symbol_table_.add_variant(e->var_name, alloca);
+    symbol_table_.add_variant(e.var_name, alloca);
 
     // Emit the body of the loop.  This, like any other expr, can change the
     // current BB.  Note that we ignore the value computed by the body, but don't
     // allow an error.
-    codegen(std::move(e->body));
+    codegen(e.body);
     if (!err_.empty()) {
         return nullptr;
     }
 
     llvm::Value* step_value = nullptr;
-    if (e->step) {
-        step_value = codegen(std::move(e->step));
+    if (e.step) {
+        step_value = codegen(e.step);
         if (!step_value) {
             return nullptr;
         }
+    } else if (is_integer) {
+        step_value = llvm::ConstantInt::get(var_type, 1); // default step is 1
     } else {
         step_value = llvm::ConstantFP::get(*context_, llvm::APFloat(1.0)); // default step is 1.0
     }
 
     // llvm::Value* next_var = builder_->CreateFAdd(phi, step_value, "nextvar");
-    auto end_condition = codegen(std::move(e->end));
+    auto end_condition = codegen(e.end);
     if (!end_condition) {
         return nullptr;
     }
 
     // Reload, increment, and restore the alloca.  This handles the case where
     // the body of the loop mutates the variable.
-    llvm::Value* now_var = builder_->CreateLoad(alloca->getAllocatedType(), alloca, std::string(e->var_name));
-    llvm::Value* next_var = builder_->CreateFAdd(now_var, step_value, "nextvar");
+    llvm::Value* now_var = builder_->CreateLoad(alloca->getAllocatedType(), alloca, e.var_name.str());
+    llvm::Value* next_var = is_integer
+        ? builder_->CreateNSWAdd(now_var, step_value, "nextvar")
+        : builder_->CreateFAdd(now_var, step_value, "nextvar");
     builder_->CreateStore(next_var, alloca);
-
-    end_condition = builder_->CreateFCmpONE(
-        end_condition, llvm::ConstantFP::get(*context_, llvm::APFloat(0.0)), "loopcond");
     
     // llvm::BasicBlock* loop_end_block = builder_->GetInsertBlock();
     llvm::BasicBlock* after_block = llvm::BasicBlock::Create(*context_, "afterloop", function);
@@ -339,17 +331,14 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<ForExpr> e) {
     return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*context_));
 }
 
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<IfExpr> e) {
-    assert(!e->then.data.empty() && !e->_else.data.empty());
+llvm::Value* CodeGenerator::codegen(const IfExpr& e) {
+    assert(!e.then.data.empty() && !e._else.data.empty());
     
-    auto cond_value = codegen(std::move(e->condition));
+    auto cond_value = codegen(e.condition);
     if (!cond_value) {
         return nullptr;
     }
 
-    cond_value = builder_->CreateFCmpONE(
-        cond_value, llvm::ConstantFP::get(*context_, llvm::APFloat(0.0)), "ifcond");
-    
     llvm::Function* function = builder_->GetInsertBlock()->getParent();
 
     llvm::BasicBlock* then_block = llvm::BasicBlock::Create(*context_, "then", function);
@@ -361,7 +350,7 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<IfExpr> e) {
 
     llvm::Value* then_value = nullptr;
     
-    then_value = codegen(std::move(e->then));
+    then_value = codegen(e.then);
     if (!err_.empty()) {
         return nullptr;
     }
@@ -378,7 +367,7 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<IfExpr> e) {
     
     builder_->SetInsertPoint(else_block);
 
-    llvm::Value* else_value = codegen(std::move(e->_else));
+    llvm::Value* else_value = codegen(e._else);
     if (!err_.empty()) {
         return nullptr;
     } 
@@ -406,23 +395,31 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<IfExpr> e) {
     return nullptr;
 }
 
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<CallExpr> e) {
-    //llvm::Function* callee_func = module_->getFunction(e->callee);
-    auto callee_func = get_function(e->callee);
+llvm::Value* CodeGenerator::codegen(const CallExpr& e) {
+    if (e.conversion != TypeSystem::BuiltinTypes::uninit) {
+        auto value = codegen(e.args[0]);
+        if (!value) {
+            return nullptr;
+        }
+        return convert(value, type_manager_.get(e.conversion)->llvm_type(*context_));
+    }
+
+    //llvm::Function* callee_func = module_->getFunction(e.callee);
+    auto callee_func = get_function(e.callee);
 
     if (!callee_func) {
         err_ = "Unknown function referenced";
         return nullptr;
     }
 
-    if (callee_func->arg_size() != e->args.size()) {
+    if (callee_func->arg_size() != e.args.size()) {
         err_ = "Incorrect # arguments passed";
         return nullptr;
     }
 
     std::vector<llvm::Value*> args_values{};
-    for (auto & arg : e->args) {
-        args_values.push_back(codegen(std::move(arg)));
+    for (auto & arg : e.args) {
+        args_values.push_back(codegen(arg));
         if (!args_values.back()) {
             return nullptr;
         }
@@ -431,19 +428,39 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<CallExpr> e) {
     return builder_->CreateCall(callee_func, args_values, "calltmp");
 }
 
+llvm::Value* CodeGenerator::convert(llvm::Value* value, llvm::Type* type) {
+    auto from = value->getType();
+    if (from == type) {
+        return value;
+    }
+    if (type->isIntegerTy(1)) {
+        return from->isIntegerTy()
+            ? builder_->CreateICmpNE(value, llvm::ConstantInt::get(from, 0), "tobool")
+            : builder_->CreateFCmpONE(value, llvm::ConstantFP::get(from, 0.0), "tobool");
+    }
+    if (from->isIntegerTy(1)) {
+        return type->isIntegerTy()
+            ? builder_->CreateZExt(value, type, "frombool")
+            : builder_->CreateUIToFP(value, type, "frombool");
+    }
+    return type->isIntegerTy()
+        ? builder_->CreateFPToSI(value, type, "toint")
+        : builder_->CreateSIToFP(value, type, "todouble");
+}
+
 /*
-this function should synchronize changed with JitCodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) 
+this function should synchronize changed with JitCodeGenerator::codegen(BinaryExpr* e) 
 */
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
+llvm::Value* CodeGenerator::codegen(const BinaryExpr& e) {
     // Special case '=' because we don't want to emit the LHS as an expression.
-    if (e->oper == "=") {
-        auto lhse = static_cast<VariableExpr*>(e->lhs.get());
+    if (e.oper == Symbols::assign) {
+        auto lhse = static_cast<const VariableExpr*>(e.lhs);
         if (!lhse) {
             err_ = "destination of '=' must be a variable";
             return nullptr;
         }
 
-        llvm::Value* rhs_value = codegen(std::move(e->rhs));
+        llvm::Value* rhs_value = codegen(e.rhs);
         if (!err_.empty()) {
             return nullptr;
         }
@@ -453,7 +470,7 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
                 std::vector<llvm::Value*> offset_values {llvm::ConstantInt::get(*context_, llvm::APInt(32, 0))};
                 for (auto& index: lhse->addrs) {
                     auto& taked_index = std::get<ExpressionPtr>(index);
-                    if (auto offset_value = codegen(std::move(taked_index))) {
+                    if (auto offset_value = codegen(taked_index)) {
                         offset_values.push_back(offset_value);
                     } else {
                         return nullptr;
@@ -461,7 +478,7 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
                 }
 
                 if (!symbol_table_.store(builder_.get(), lhse->name, rhs_value, offset_values)) {
-                    err_ = "SymbolTable store " + lhse->name + "failed.";
+                    err_ = "SymbolTable store " + std::string(lhse->name.str()) + "failed.";
                     return nullptr;
                 }                
             } else {
@@ -470,23 +487,23 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
                 for (auto& addr: lhse->addrs) {
                     if (std::holds_alternative<ExpressionPtr>(addr)) {
                         auto& taked_index = std::get<ExpressionPtr>(addr);
-                        if (auto offset_value = codegen(std::move(taked_index))) {
+                        if (auto offset_value = codegen(taked_index)) {
                             element_or_offsets.emplace_back(offset_value);
                         } else {
                             return nullptr;
                         }                        
                     } else {
-                        element_or_offsets.emplace_back(std::get<std::string>(addr));
+                        element_or_offsets.emplace_back(std::get<VariableExpr::Field>(addr).index);
                     }
                 }
-                if (!symbol_table_.store(builder_.get(), lhse->name, rhs_value, element_or_offsets, type_manager_)) {
-                    err_ = "SymbolTable store " + lhse->name + "failed.";
+                if (!symbol_table_.store(builder_.get(), lhse->name, rhs_value, element_or_offsets)) {
+                    err_ = "SymbolTable store " + std::string(lhse->name.str()) + "failed.";
                     return nullptr;
                 } 
             }
         } else {
             if (!symbol_table_.store(builder_.get(), lhse->name, rhs_value)) {
-                err_ = "SymbolTable store " + lhse->name + "failed.";
+                err_ = "SymbolTable store " + std::string(lhse->name.str()) + "failed.";
                 return nullptr;
             }            
         }
@@ -494,8 +511,8 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
         return rhs_value; // support a = (b = c);
     }
     
-    llvm::Value* l = codegen(std::move(e->lhs));
-    llvm::Value* r = codegen(std::move(e->rhs));
+    llvm::Value* l = codegen(e.lhs);
+    llvm::Value* r = codegen(e.rhs);
     if (!r || !l) {
         return nullptr;
     }
@@ -509,28 +526,28 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
         return nullptr;
     }
 
-    if (!operator_function_manager_.exist(type, e->oper)) {
-        llvm::Function* function_value = get_function(e->oper);
+    if (!operator_function_manager_.exist(type, e.oper)) {
+        llvm::Function* function_value = get_function(e.oper);
         assert(function_value && "binary operator not found!");
         sleep(1);
-        operator_function_manager_.add_function(type, e->oper, function_value);
+        operator_function_manager_.add_function(type, e.oper, function_value);
     }
 
-    auto f = operator_function_manager_.get_function(type, e->oper);
+    auto f = operator_function_manager_.get_function(type, e.oper);
     return f(builder_.get(), l, r);
 }
 
 // def f() -> double {var x:array%array%double%2%2 = [[2, 2]:double, [3, 3]:double]:double; x[0][1] = 4; return x[0][1] + x[1][0];}
 
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<VariableExpr> e) {
-    if (auto ret = symbol_table_.load(builder_.get(), e->name)) {
-        if (!e->addrs.empty()) {
-            if (e->is_array_offset) {
+llvm::Value* CodeGenerator::codegen(const VariableExpr& e) {
+    if (auto ret = symbol_table_.load(builder_.get(), e.name)) {
+        if (!e.addrs.empty()) {
+            if (e.is_array_offset) {
                 std::vector<llvm::Value*> offset_values {llvm::ConstantInt::get(*context_, llvm::APInt(32, 0))};
                 
-                for (auto& offset: e->addrs) {
+                for (auto& offset: e.addrs) {
                     auto& taked_offset = std::get<ExpressionPtr>(offset);
-                    auto offset_value = codegen(std::move(taked_offset));
+                    auto offset_value = codegen(taked_offset);
                     if (!offset_value) {
                         return nullptr;
                     }
@@ -545,12 +562,11 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<VariableExpr> e) {
             } else {
                 auto target_llvm_type = static_cast<llvm::AllocaInst*>(ret)->getAllocatedType();
                 llvm::Value* target_ptr = nullptr;
-                auto target_front_end_type_str = symbol_table_.find_symbol_type_str(e->name);
-                for (auto& addr: e->addrs) {
+                for (auto& addr: e.addrs) {
                     std::vector<llvm::Value*> offset_values {llvm::ConstantInt::get(*context_, llvm::APInt(32, 0))};
                     if (std::holds_alternative<ExpressionPtr>(addr)) {
-                        auto taked_offset = std::move(std::get<ExpressionPtr>(addr));
-                        auto offset_value = codegen(std::move(taked_offset));
+                        auto taked_offset = std::get<ExpressionPtr>(addr);
+                        auto offset_value = codegen(taked_offset);
                         if (!offset_value) {
                             return nullptr;
                         }
@@ -558,19 +574,13 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<VariableExpr> e) {
                         target_ptr = builder_->CreateInBoundsGEP(target_llvm_type, ret, offset_values, "offset");
                         ret = target_ptr;
                         target_llvm_type = static_cast<llvm::ArrayType*>(target_llvm_type)->getArrayElementType();
-                        target_front_end_type_str = TypeSystem::extract_nesting_type(target_front_end_type_str).first;
                     } else {
-                        // auto& target_front_end_type = struct_table_.at(target_front_end_type_str);
-                        auto target_front_end_type = type_manager_.find_type_by_name(target_front_end_type_str);
-                        auto target_front_end_type_raw = static_cast<TypeSystem::AggregateType*>(target_front_end_type.get());
-                        auto& taked_element_name = std::get<std::string>(addr);
-                        unsigned int index = target_front_end_type_raw->element_position(taked_element_name);
+                        unsigned int index = std::get<VariableExpr::Field>(addr).index;
 
                         offset_values.push_back(llvm::ConstantInt::get(*context_, llvm::APInt(32, index)));
                         target_ptr = builder_->CreateInBoundsGEP(target_llvm_type, ret, offset_values, "offset");
                         ret = target_ptr;
                         target_llvm_type = static_cast<llvm::StructType*>(target_llvm_type)->getStructElementType(index);
-                        target_front_end_type_str = target_front_end_type_raw->element_type(taked_element_name)->name();
                     }
                 }
                 ret = builder_->CreateLoad(target_llvm_type, target_ptr, "offsetValue");
@@ -579,86 +589,27 @@ llvm::Value* CodeGenerator::codegen(std::unique_ptr<VariableExpr> e) {
         return ret;
     }
 
-    err_ = "SymbolTable load " + e->name + " failed.";
+    err_ = "SymbolTable load " + std::string(e.name.str()) + " failed.";
     return nullptr;
 }
 
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<LiteralExpr> e) {
-    auto& tmp = e->type;
-    auto literal_type = type_manager_.find_type_by_name(tmp);
-    return literal_type->get_llvm_value(*context_, e->value);
+llvm::Value* CodeGenerator::codegen(const LiteralExpr& e) {
+    auto literal_type = type_manager_.get(e.type_id);
+    return literal_type->get_llvm_value(*context_, e.value);
 }
 
-llvm::Value* CodeGenerator::codegen(std::unique_ptr<Expression> e) {
-    Expression* raw = e.release();
-    auto l = dynamic_cast<LiteralExpr*>(raw);
-    if (l) {
-        std::unique_ptr<LiteralExpr> tmp(l);
-        return codegen(std::move(tmp));
-    }
-
-    auto c = dynamic_cast<CallExpr*>(raw);
-    if (c) {
-        std::unique_ptr<CallExpr> tmp(c);
-        return codegen(std::move(tmp));
-    }
-    
-    auto v = dynamic_cast<VariableExpr*>(raw);
-    if (v) {
-        std::unique_ptr<VariableExpr> tmp(v);
-        return codegen(std::move(tmp));
-    }
-    
-    auto b = dynamic_cast<BinaryExpr*>(raw);
-    if (b) {
-        std::unique_ptr<BinaryExpr> tmp(b);
-        return codegen(std::move(tmp));
-    }
-
-    auto i = dynamic_cast<IfExpr*>(raw);
-    if (i) {
-        std::unique_ptr<IfExpr> tmp(i);
-        return codegen(std::move(tmp));        
-    }
-
-    auto f = dynamic_cast<ForExpr*>(raw);
-    if (f) {
-        std::unique_ptr<ForExpr> tmp(f);
-        return codegen(std::move(tmp));
-    }
-
-    auto u = dynamic_cast<UnaryExpr*>(raw);
-    if (u) {
-        std::unique_ptr<UnaryExpr> tmp(u);
-        return codegen(std::move(tmp));        
-    }
-
-    auto var = dynamic_cast<VarDeclareExpr*>(raw);
-    if (var) {
-        std::unique_ptr<VarDeclareExpr> tmp(var);
-        return codegen(std::move(tmp));  
-    }
-
-    auto r = dynamic_cast<ReturnExpr*>(raw);
-    if (r) {
-        std::unique_ptr<ReturnExpr> tmp(r);
-        return codegen(std::move(tmp));  
-    }
-
-    auto arr = dynamic_cast<ArrayExpr*>(raw);
-    if (arr) {
-        std::unique_ptr<ArrayExpr> tmp(arr);
-        return codegen(std::move(tmp));          
+llvm::Value* CodeGenerator::codegen(const Expression* e) {
+    if (!e) {
+        return nullptr;
     }
-
-    return nullptr;
+    return visit_expression(e, [&](auto* node) { return codegen(*node); });
 }
 
-llvm::Value* CodeGenerator::codegen(Body b) {
+llvm::Value* CodeGenerator::codegen(const Body& b) {
     llvm::Value* tmp = nullptr;
 
     for (auto& expr: b.data) {
-        tmp = codegen(std::move(expr));
+        tmp = codegen(expr);
         if (!err_.empty()) {
             return nullptr;
         }
@@ -670,37 +621,36 @@ llvm::Value* CodeGenerator::codegen(Body b) {
     }
 }
 
-llvm::Function* CodeGenerator::codegen(ProtoTypePtr p) {
-    assert(p);
-
+llvm::Function* CodeGenerator::codegen(const ProtoType& p) {
     std::vector<llvm::Type*> arg_types;
-    for (auto& arg: p->args) {
+    for (auto& arg: p.args) {
         auto arg_type = type_manager_.find_type_by_name(arg.second);
         arg_types.push_back(arg_type->llvm_type(*context_));
     }
-    auto answer_type = type_manager_.find_type_by_name(p->answer);
+    auto answer_type = type_manager_.find_type_by_name(p.answer);
     llvm::Type* result_type = answer_type->llvm_type(*context_);
     llvm::FunctionType* function_type = llvm::FunctionType::get(result_type, arg_types, false);
     llvm::Function* function = llvm::Function::Create(
         function_type, 
         llvm::Function::ExternalLinkage,
-        p->name,
+        p.name.str(),
         module_.get()
     );
 
     unsigned idx = 0;
-    assert(function->arg_size() == p->args.size());
+    assert(function->arg_size() == p.args.size());
     for (auto& arg: function->args()) {
-        arg.setName(p->args[idx++].first);
+        arg.setName(p.args[idx++].first.str());
     }
     return function;
 }
 
-llvm::Function* CodeGenerator::codegen(FunctionNode& f) {
-    // Transfer ownership of the prototype to the FunctionProtos map
+llvm::Function* CodeGenerator::codegen(const FunctionNode& f) {
+    // an error of an earlier attempt must not fail this one
+    err_.clear();
 
     auto name = f.prototype->name;
-    function_protos_[name] = std::move(*f.prototype);
+    function_protos_[name] = f.prototype->copy_to(proto_arena_);
     auto function = get_function(name);
 
     if (!function) {
@@ -711,16 +661,19 @@ llvm::Function* CodeGenerator::codegen(FunctionNode& f) {
     builder_->SetInsertPoint(basic_block);
 
     // Record the function arguments in the NamedValues map.
-    // named_values_alloca_.clear();
+    // an earlier function which failed halfway may have left its scopes open
+    symbol_table_.clear();
     symbol_table_.step();
+    auto& proto_args = function_protos_[name].args;
+    unsigned idx = 0;
     for (auto& arg: function->args()) {
         // Create an alloca for this variable.
-        auto alloca = create_entry_block_alloca(function, std::string(arg.getName()), arg.getType());
+        auto alloca = create_entry_block_alloca(function, arg.getName(), arg.getType());
 
         // Store the initial value into the alloca.
         builder_->CreateStore(&arg, alloca);
 
-        symbol_table_.add_variant(std::string(arg.getName()), alloca);
+        symbol_table_.add_variant(proto_args[idx++].first, alloca);
     }
 
     return_block = llvm::BasicBlock::Create(*context_, "return");
@@ -728,7 +681,7 @@ llvm::Function* CodeGenerator::codegen(FunctionNode& f) {
     auto& return_inserting_blocks = function->getBasicBlockList();
     return_inserting_blocks.insert(function->end(), return_block); 
 
-    codegen(std::move(f.body));
+    codegen(f.body);
     if (err_.empty()) {
         builder_->SetInsertPoint(return_block);
         llvm::Value* ret_value = builder_->CreateLoad(ret_alloca->getAllocatedType(), ret_alloca, "final");
@@ -737,8 +690,9 @@ llvm::Function* CodeGenerator::codegen(FunctionNode& f) {
         // Validate the generated code, checking for consistency.
         llvm::verifyFunction(*function);
 
-        if (setting_.function_pass_optimize) {
-            function_pass_manager_->run(*function);
+        // an anonymous expression runs once, it is not worth simplifying
+        if (setting_.function_pass_optimize && f.prototype->name != Symbols::anon_expr) {
+            optimizer_->run(*function);
         }
         
         symbol_table_.back();
@@ -752,11 +706,12 @@ llvm::Function* CodeGenerator::codegen(FunctionNode& f) {
 
 void CodeGenerator::codegen(std::vector<ASTNodePtr>&& ast_tree) {
     for (auto& ast: ast_tree) {
+        bool lowered = false;
         ast->match(
             [&](ExternNode& e) {
-                std::string name = e.prototype->name;
-                function_protos_[name] = *e.prototype;
-                if (auto ir = codegen(std::move(e.prototype))) {
+                Symbol name = e.prototype->name;
+                function_protos_[name] = e.prototype->copy_to(proto_arena_);
+                if (auto ir = codegen(*e.prototype)) {
                     ir->print(output_stream_);
                 } else {
                     output_stream_ << err_ << '\n';
@@ -764,7 +719,7 @@ void CodeGenerator::codegen(std::vector<ASTNodePtr>&& ast_tree) {
                 }
             },
             [&](FunctionNode& f) {
-                bool is_top = f.prototype->name == "__anon_expr";
+                bool is_top = f.prototype->name == Symbols::anon_expr;
                 if (is_top) {
                     output_stream_ << "shouldn't use exec without jit.\n";
                 } else {
@@ -774,6 +729,7 @@ void CodeGenerator::codegen(std::vector<ASTNodePtr>&& ast_tree) {
                         } else {
                             output_stream_ << "parsed function definition.\n";
                         }
+                        lowered = true;
                     } else {
                         output_stream_ << err_ << '\n';
                     }                        
@@ -784,19 +740,33 @@ void CodeGenerator::codegen(std::vector<ASTNodePtr>&& ast_tree) {
                 output_stream_ << "parsed struct definition.\n";
             }
         );
+        if (lowered) {
+            retain_function(std::move(ast));
+        }
+    }
+}
+
+void CodeGenerator::retain_function(ASTNodePtr ast) {
+    auto& f = std::get<FunctionNode>(ast->data);
+    function_nodes_[f.prototype->name] = std::move(ast);
+}
+
+const FunctionNode* CodeGenerator::find_function_node(Symbol name) const {
+    auto iter = function_nodes_.find(name);
+    if (iter == function_nodes_.end()) {
+        return nullptr;
     }
+    return &std::get<FunctionNode>(iter->second->data);
 }
 
-llvm::Function* CodeGenerator::get_function(std::string& name) {
-    if (auto f = module_->getFunction(name)) {
+llvm::Function* CodeGenerator::get_function(Symbol name) {
+    if (auto f = module_->getFunction(name.str())) {
         return f;
     }
 
     auto iter = function_protos_.find(name);
     if (iter != function_protos_.end()) {
-        auto proto = iter->second;
-        auto ans = codegen(std::make_unique<ProtoType>(proto));
-        return ans;
+        return codegen(iter->second);
     }
 
     output_stream_ << "not find function!\n";
@@ -4,7 +4,6 @@
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/LLVMContext.h>
-#include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Value.h>
 #include <llvm/Support/Error.h>
@@ -14,14 +13,32 @@
 #include <unordered_map>
 
 #include "ast/ast.hpp"
+#include "ast/symbol.hpp"
 #include "ast/type.hpp"
+#include "interpreter.hpp"
 #include "jit_engine.hpp"
+#include "object_cache.hpp"
 #include "operator_function.hpp"
+#include "optimizer.hpp"
 #include "symbol_table.hpp"
+#include "target.hpp"
 
 struct CodeGeneratorSetting {
     bool print_ir = true;
+    // aot only, simplify each function as soon as it is lowered, for the ir printed as it goes;
+    // objects always get the module pipeline, which simplifies every function itself
     bool function_pass_optimize = true;
+    OptLevel opt_level = OptLevel::O2;
+    TargetSelection target;
+    bool lazy_compile = false; // jit only, compile a function on its first call rather than when defined
+    // jit only, start functions on an O0 baseline and recompile them at O3 once called this often
+    bool tiered_compile = false;
+    unsigned hot_call_threshold = 1000;
+    unsigned compile_threads = 0; // jit only, 0 compiles on the thread which looks a function up first
+    ObjectCacheSetting object_cache; // jit only, reuses the objects an earlier run compiled
+    bool batch_execs = true; // jit only, consecutive execs of one codegen call are compiled as one module
+    unsigned exec_cache_size = 64; // jit only, compiled execs kept to run again when the same exec comes, 0 disables
+    ExecMode exec_mode = ExecMode::Auto; // jit only, whether execs are compiled or interpreted
 };
 
 class CodeGenerator {
@@ -30,42 +47,53 @@ public:
                            bool init = true);
     virtual ~CodeGenerator() = default;
 
-    llvm::Value* codegen(std::unique_ptr<ArrayExpr> e);
-    llvm::Value* codegen(Body b);
-    llvm::Value* codegen(std::unique_ptr<ReturnExpr> e);
-    llvm::Value* codegen(std::unique_ptr<VarDeclareExpr> e);
-    llvm::Value* codegen(std::unique_ptr<UnaryExpr> e);
-    llvm::Value* codegen(std::unique_ptr<ForExpr> e);
-    llvm::Value* codegen(std::unique_ptr<IfExpr> e);
-    llvm::Value* codegen(std::unique_ptr<CallExpr> e);
-    llvm::Value* codegen(std::unique_ptr<VariableExpr> e);
-    llvm::Value* codegen(std::unique_ptr<LiteralExpr> e);
-    llvm::Value* codegen(std::unique_ptr<Expression> e);
-    virtual llvm::Value* codegen(std::unique_ptr<BinaryExpr> e);
+    llvm::Value* codegen(const ArrayExpr& e);
+    llvm::Value* codegen(const Body& b);
+    llvm::Value* codegen(const ReturnExpr& e);
+    llvm::Value* codegen(const VarDeclareExpr& e);
+    llvm::Value* codegen(const UnaryExpr& e);
+    llvm::Value* codegen(const ForExpr& e);
+    llvm::Value* codegen(const IfExpr& e);
+    llvm::Value* codegen(const CallExpr& e);
+    llvm::Value* codegen(const VariableExpr& e);
+    llvm::Value* codegen(const LiteralExpr& e);
+    llvm::Value* codegen(const Expression* e);
+    virtual llvm::Value* codegen(const BinaryExpr& e);
 
-    llvm::Function* codegen(ProtoTypePtr p);
-    llvm::Function* codegen(FunctionNode& f);
+    llvm::Function* codegen(const ProtoType& p);
+    llvm::Function* codegen(const FunctionNode& f);
 
+    // lowers the items and keeps every function definition which made it into IR
     virtual void codegen(std::vector<ASTNodePtr>&&);
     void print(std::string&& file_addr);
 
+    // a definition lowered before, its nodes stay alive so it can be compiled again
+    [[nodiscard]] const FunctionNode* find_function_node(Symbol name) const;
+
 public:
-    std::map<std::string, int> binary_oper_precedence_ = {
-        {"=", 2}, {"<", 10}, {"+", 20}, {"-", 20}, {"*", 40}};
+    std::unordered_map<Symbol, int> binary_oper_precedence_ = {
+        {Symbols::assign, 2}, {Symbol("<"), 10}, {Symbol("+"), 20}, {Symbol("-"), 20}, {Symbol("*"), 40}};
     TypeManager type_manager_;
 protected:
-    llvm::Function* get_function(std::string& name);
+    void retain_function(ASTNodePtr ast);
+    llvm::Function* get_function(Symbol name);
+    // a checked conversion between bool, i32 and double
+    llvm::Value* convert(llvm::Value* value, llvm::Type* type);
     llvm::AllocaInst* create_entry_block_alloca(
-        llvm::Function* function, const std::string& var_name, TypeSystem::TypeBase* type);
+        llvm::Function* function, llvm::StringRef var_name, TypeSystem::TypeBase* type);
     llvm::AllocaInst* create_entry_block_alloca(
-        llvm::Function* function, const std::string& var_name, llvm::Type* type);
+        llvm::Function* function, llvm::StringRef var_name, llvm::Type* type);
 protected:
-    std::unique_ptr<llvm::LLVMContext> context_;
+    llvm::orc::ThreadSafeContext context_owner_; // shared with the jit once module_ is handed over
+    llvm::LLVMContext* context_ = nullptr;      // the one of module_
     std::unique_ptr<llvm::IRBuilder<>> builder_;
     std::unique_ptr<llvm::Module> module_;
-    std::unique_ptr<llvm::legacy::FunctionPassManager> function_pass_manager_;
+    std::unique_ptr<Optimizer> optimizer_;
+    std::unique_ptr<llvm::TargetMachine> target_machine_; // the object file one, only without a jit
 
-    std::map<std::string, ProtoType> function_protos_ = {};
+    std::unordered_map<Symbol, ProtoType> function_protos_ = {};
+    Arena proto_arena_; // keeps the arguments of function_protos_ after their parse is gone
+    std::unordered_map<Symbol, ASTNodePtr> function_nodes_ = {};
     std::string err_;
     llvm::ExitOnError exit_on_error_;
     llvm::raw_ostream& output_stream_;
@@ -0,0 +1,412 @@
+#include "interpreter.hpp"
+
+#include <llvm/ADT/SmallVector.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+using TypeSystem::BuiltinTypes::boolean;
+using TypeSystem::BuiltinTypes::f64;
+using TypeSystem::BuiltinTypes::i32;
+using TypeSystem::BuiltinTypes::uninit;
+
+const Symbol add_operator {"+"};
+const Symbol sub_operator {"-"};
+const Symbol mul_operator {"*"};
+
+bool is_scalar(TypeId type) {
+    return type == i32 || type == f64 || type == boolean;
+}
+
+// the operators the OperatorFunctionManager emits itself for i32 and double, others are calls
+bool is_builtin(Symbol op, TypeId type) {
+    return (type == i32 || type == f64)
+        && (op == add_operator || op == sub_operator || op == mul_operator || op == Symbols::less);
+}
+
+Interpreter::Value zero(TypeId type) {
+    Interpreter::Value value;
+    value.type = type;
+    return value;
+}
+
+// as CodeGenerator::convert emits it
+Interpreter::Value convert(Interpreter::Value value, TypeId type) {
+    if (value.type == type) {
+        return value;
+    }
+    Interpreter::Value ans = zero(type);
+    if (type == boolean) {
+        ans.boolean = value.type == i32 ? value.i32 != 0 : !std::isnan(value.f64) && value.f64 != 0;
+    } else if (value.type == boolean) {
+        if (type == i32) {
+            ans.i32 = value.boolean;
+        } else {
+            ans.f64 = value.boolean;
+        }
+    } else if (type == i32) {
+        ans.i32 = static_cast<int32_t>(value.f64);
+    } else {
+        ans.f64 = value.i32;
+    }
+    return ans;
+}
+
+// i32 arithmetic wraps, like the instructions it stands for
+int32_t wrap(uint32_t value) {
+    return static_cast<int32_t>(value);
+}
+
+}  // namespace
+
+void Interpreter::add_bridge(Symbol callee, Bridge bridge) {
+    bridges_[callee] = {bridge, scalar_type(protos_.at(callee).answer).value_or(uninit)};
+}
+
+std::optional<TypeId> Interpreter::scalar_type(Symbol name) {
+    auto type = types_.find_type_by_name(name);
+    if (!type || !is_scalar(type->id)) {
+        return std::nullopt;
+    }
+    return type->id;
+}
+
+std::optional<Interpreter::Plan> Interpreter::prepare(const FunctionNode& exec) {
+    auto answer = scalar_type(exec.prototype->answer);
+    if (!answer) {
+        return std::nullopt;
+    }
+    Plan plan {.answer = *answer};
+    Locals locals;
+    if (!prepare(exec.body, locals, plan)) {
+        return std::nullopt;
+    }
+    return plan;
+}
+
+std::optional<TypeId> Interpreter::prepare(const Expression* e, Locals& locals, Plan& plan) {
+    return visit_expression(e, [&](const auto* node) { return prepare_node(*node, locals, plan); });
+}
+
+std::optional<TypeId> Interpreter::prepare(const Body& body, Locals& locals, Plan& plan) {
+    std::optional<TypeId> type = uninit;
+    for (auto e: body.data) {
+        type = prepare(e, locals, plan);
+        if (!type) {
+            return std::nullopt;
+        }
+    }
+    return body.has_return_value ? type : uninit;
+}
+
+std::optional<TypeId> Interpreter::prepare_node(const ArrayExpr&, Locals&, Plan&) {
+    return std::nullopt;
+}
+
+std::optional<TypeId> Interpreter::prepare_node(const LiteralExpr& e, Locals&, Plan&) {
+    return is_scalar(e.type_id) ? std::optional(e.type_id) : std::nullopt;
+}
+
+std::optional<TypeId> Interpreter::prepare_node(const VariableExpr& e, Locals& locals, Plan&) {
+    if (!e.addrs.empty()) {
+        return std::nullopt;
+    }
+    auto found = std::find_if(locals.rbegin(), locals.rend(), [&](auto& local) { return local.first == e.name; });
+    return found == locals.rend() ? std::nullopt : std::optional(found->second);
+}
+
+std::optional<TypeId> Interpreter::prepare_node(const BinaryExpr& e, Locals& locals, Plan& plan) {
+    if (e.oper == Symbols::assign) {
+        auto destination = expr_cast<VariableExpr>(e.lhs);
+        if (!destination) {
+            return std::nullopt;
+        }
+        auto value = prepare(e.rhs, locals, plan);
+        auto type = prepare(e.lhs, locals, plan);
+        return value && type && *value == *type ? value : std::nullopt;
+    }
+
+    auto lhs = prepare(e.lhs, locals, plan);
+    auto rhs = prepare(e.rhs, locals, plan);
+    if (!lhs || !rhs || *lhs != *rhs || !is_scalar(*lhs)) {
+        return std::nullopt;
+    }
+    if (is_builtin(e.oper, *lhs)) {
+        return e.oper == Symbols::less ? boolean : *lhs;
+    }
+    // bool operands would take the i1 instructions, those stay with the jit
+    if (*lhs == boolean && is_builtin(e.oper, i32)) {
+        return std::nullopt;
+    }
+    return prepare_call(e.oper, {*lhs, *rhs}, plan);
+}
+
+std::optional<TypeId> Interpreter::prepare_node(const CallExpr& e, Locals& locals, Plan& plan) {
+    std::vector<TypeId> args;
+    for (auto arg: e.args) {
+        auto type = prepare(arg, locals, plan);
+        if (!type || !is_scalar(*type)) {
+            return std::nullopt;
+        }
+        args.push_back(*type);
+    }
+    if (e.conversion != uninit) {
+        return args.size() == 1 && is_scalar(e.conversion) ? std::optional(e.conversion) : std::nullopt;
+    }
+    return prepare_call(e.callee, args, plan);
+}
+
+std::optional<TypeId> Interpreter::prepare_call(Symbol callee, const std::vector<TypeId>& args, Plan& plan) {
+    auto proto = protos_.find(callee);
+    if (proto == protos_.end() || proto->second.args.size() != args.size()) {
+        return std::nullopt;
+    }
+    for (size_t i = 0; i < args.size(); i++) {
+        if (scalar_type(proto->second.args[i].second) != args[i]) {
+            return std::nullopt;
+        }
+    }
+    auto answer = scalar_type(proto->second.answer);
+    if (answer && std::find(plan.callees.begin(), plan.callees.end(), callee) == plan.callees.end()) {
+        plan.callees.push_back(callee);
+    }
+    return answer;
+}
+
+std::optional<TypeId> Interpreter::prepare_node(const IfExpr& e, Locals& locals, Plan& plan) {
+    if (prepare(e.condition, locals, plan) != boolean) {
+        return std::nullopt;
+    }
+    auto then = prepare(e.then, locals, plan);
+    auto otherwise = prepare(e._else, locals, plan);
+    if (!then || !otherwise) {
+        return std::nullopt;
+    }
+    // a value on one side only does not lower
+    return *then == *otherwise ? then : std::nullopt;
+}
+
+std::optional<TypeId> Interpreter::prepare_node(const ForExpr& e, Locals& locals, Plan& plan) {
+    if ((e.type_id != i32 && e.type_id != f64) || prepare(e.start, locals, plan) != e.type_id) {
+        return std::nullopt;
+    }
+    plan.loops = true;
+    // variables of the body stay visible to the step and the end condition
+    auto scope = locals.size();
+    locals.emplace_back(e.var_name, e.type_id);
+    bool runs = prepare(e.body, locals, plan)
+        && (!e.step || prepare(e.step, locals, plan) == e.type_id)
+        && prepare(e.end, locals, plan) == boolean;
+    locals.resize(scope);
+    return runs ? std::optional(f64) : std::nullopt;
+}
+
+std::optional<TypeId> Interpreter::prepare_node(const UnaryExpr& e, Locals& locals, Plan& plan) {
+    auto operand = prepare(e.operand, locals, plan);
+    if (!operand || !is_scalar(*operand) || e._operater.empty()) {
+        return std::nullopt;
+    }
+    return prepare_call(e._operater, {*operand}, plan);
+}
+
+std::optional<TypeId> Interpreter::prepare_node(const VarDeclareExpr& e, Locals& locals, Plan& plan) {
+    if (!is_scalar(e.type_id) || (e.value && prepare(e.value, locals, plan) != e.type_id)) {
+        return std::nullopt;
+    }
+    locals.emplace_back(e.name, e.type_id);
+    return uninit;
+}
+
+std::optional<TypeId> Interpreter::prepare_node(const ReturnExpr& e, Locals& locals, Plan& plan) {
+    if (e.ret && prepare(e.ret, locals, plan) != plan.answer) {
+        return std::nullopt;
+    }
+    return uninit;
+}
+
+Interpreter::Value Interpreter::run(const FunctionNode& exec) {
+    locals_.clear();
+    returned_ = false;
+    // what the return slot holds when nothing was returned
+    answer_ = zero(scalar_type(exec.prototype->answer).value_or(uninit));
+    eval(exec.body);
+    return answer_;
+}
+
+Interpreter::Value Interpreter::eval(const Expression* e) {
+    return visit_expression(e, [&](const auto* node) { return eval_node(*node); });
+}
+
+Interpreter::Value Interpreter::eval(const Body& body) {
+    Value value;
+    for (auto e: body.data) {
+        value = eval(e);
+        if (returned_) {
+            return Value();
+        }
+    }
+    return body.has_return_value ? value : Value();
+}
+
+Interpreter::Value& Interpreter::local(Symbol name) {
+    auto found = std::find_if(locals_.rbegin(), locals_.rend(), [&](auto& local) { return local.first == name; });
+    assert(found != locals_.rend() && "prepare() let an unknown variable through");
+    return found->second;
+}
+
+Interpreter::Value Interpreter::eval_node(const ArrayExpr&) {
+    assert(false && "prepare() let an array through");
+    return Value();
+}
+
+Interpreter::Value Interpreter::eval_node(const LiteralExpr& e) {
+    Value value = zero(e.type_id);
+    if (e.type_id == i32) {
+        value.i32 = static_cast<int>(e.value);
+    } else if (e.type_id == f64) {
+        value.f64 = e.value;
+    } else {
+        value.boolean = e.value != 0;
+    }
+    return value;
+}
+
+Interpreter::Value Interpreter::eval_node(const VariableExpr& e) {
+    return local(e.name);
+}
+
+Interpreter::Value Interpreter::eval_node(const BinaryExpr& e) {
+    if (e.oper == Symbols::assign) {
+        Value value = eval(e.rhs);
+        local(static_cast<const VariableExpr*>(e.lhs)->name) = value;
+        return value;
+    }
+
+    Value lhs = eval(e.lhs);
+    Value rhs = eval(e.rhs);
+    if (!is_builtin(e.oper, lhs.type)) {
+        Value args[2] = {lhs, rhs};
+        return call(e.oper, args);
+    }
+    if (e.oper == Symbols::less) {
+        Value ans = zero(boolean);
+        // the double compare is unordered, a NaN on either side is less
+        ans.boolean = lhs.type == i32 ? lhs.i32 < rhs.i32 : !(lhs.f64 >= rhs.f64);
+        return ans;
+    }
+    Value ans = zero(lhs.type);
+    if (lhs.type == i32) {
+        auto l = static_cast<uint32_t>(lhs.i32);
+        auto r = static_cast<uint32_t>(rhs.i32);
+        ans.i32 = wrap(e.oper == add_operator ? l + r : e.oper == sub_operator ? l - r : l * r);
+    } else {
+        ans.f64 = e.oper == add_operator ? lhs.f64 + rhs.f64
+            : e.oper == sub_operator ? lhs.f64 - rhs.f64 : lhs.f64 * rhs.f64;
+    }
+    return ans;
+}
+
+Interpreter::Value Interpreter::eval_node(const CallExpr& e) {
+    llvm::SmallVector<Value, 4> args;
+    for (auto arg: e.args) {
+        args.push_back(eval(arg));
+    }
+    if (e.conversion != uninit) {
+        return convert(args[0], e.conversion);
+    }
+    return call(e.callee, args);
+}
+
+Interpreter::Value Interpreter::call(Symbol callee, llvm::ArrayRef<Value> args) {
+    llvm::SmallVector<uint64_t, 4> slots(args.size(), 0);
+    for (size_t i = 0; i < args.size(); i++) {
+        auto& arg = args[i];
+        if (arg.type == i32) {
+            std::memcpy(&slots[i], &arg.i32, sizeof(arg.i32));
+        } else if (arg.type == f64) {
+            std::memcpy(&slots[i], &arg.f64, sizeof(arg.f64));
+        } else {
+            std::memcpy(&slots[i], &arg.boolean, sizeof(arg.boolean));
+        }
+    }
+
+    auto& [bridge, answer_type] = bridges_.at(callee);
+    uint64_t answer = 0;
+    bridge(slots.data(), &answer);
+
+    Value ans = zero(answer_type);
+    if (answer_type == i32) {
+        std::memcpy(&ans.i32, &answer, sizeof(ans.i32));
+    } else if (answer_type == f64) {
+        std::memcpy(&ans.f64, &answer, sizeof(ans.f64));
+    } else {
+        std::memcpy(&ans.boolean, &answer, sizeof(ans.boolean));
+    }
+    return ans;
+}
+
+Interpreter::Value Interpreter::eval_node(const IfExpr& e) {
+    Value condition = eval(e.condition);
+    if (returned_) {
+        return Value();
+    }
+    return eval(condition.boolean ? e.then : e._else);
+}
+
+Interpreter::Value Interpreter::eval_node(const ForExpr& e) {
+    Value start = eval(e.start);
+    auto scope = locals_.size();
+    locals_.emplace_back(e.var_name, start);
+    for (;;) {
+        eval(e.body);
+        if (returned_) {
+            break;
+        }
+        Value step = zero(e.type_id);
+        if (e.step) {
+            step = eval(e.step);
+        } else if (e.type_id == i32) {
+            step.i32 = 1;
+        } else {
+            step.f64 = 1;
+        }
+        // the end condition sees the variable before the step, the loop runs at least once
+        Value end = eval(e.end);
+        auto& variable = locals_[scope].second;
+        if (e.type_id == i32) {
+            variable.i32 = wrap(static_cast<uint32_t>(variable.i32) + static_cast<uint32_t>(step.i32));
+        } else {
+            variable.f64 += step.f64;
+        }
+        if (!end.boolean) {
+            break;
+        }
+        locals_.resize(scope + 1);
+    }
+    locals_.resize(scope);
+    return zero(f64);
+}
+
+Interpreter::Value Interpreter::eval_node(const UnaryExpr& e) {
+    Value operand = eval(e.operand);
+    return call(e._operater, operand);
+}
+
+Interpreter::Value Interpreter::eval_node(const VarDeclareExpr& e) {
+    Value value = e.value ? eval(e.value) : zero(e.type_id);
+    locals_.emplace_back(e.name, value);
+    return Value();
+}
+
+Interpreter::Value Interpreter::eval_node(const ReturnExpr& e) {
+    Value value = e.ret ? eval(e.ret) : answer_;
+    if (!returned_) {
+        answer_ = value;
+        returned_ = true;
+    }
+    return Value();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+
+#include "ast/ast.hpp"
+#include "ast/type.hpp"
+
+/// ExecMode chooses how the jit runs an exec: compiled, or walked by the Interpreter when it can.
+enum class ExecMode {
+    Jit,
+    Interpret,
+    Auto, // interprets the execs without a loop, their cost is bounded by their size
+};
+
+/// Interpreter runs a checked exec by walking its ast, where lowering and linking it would cost
+/// far more than the evaluation. It knows bool, i32 and double values and follows the semantics of
+/// the code the CodeGenerator emits. Calls go to the jitted functions and externs through a bridge
+/// per callee, which the jit compiles once.
+class Interpreter {
+public:
+    // reads the arguments from their slots and writes the answer to the first bytes of its slot
+    using Bridge = void (*)(const uint64_t* args, uint64_t* answer);
+
+    struct Value {
+        TypeId type = TypeSystem::BuiltinTypes::uninit; // uninit when the expression has no value
+        union {
+            int32_t i32;
+            double f64;
+            bool boolean;
+        };
+        Value(): f64(0) {}
+    };
+
+    // what an exec needs before it runs
+    struct Plan {
+        TypeId answer;
+        std::vector<Symbol> callees; // every function the exec calls, without repeats
+        bool loops = false;
+    };
+
+    Interpreter(TypeManager& types, const std::unordered_map<Symbol, ProtoType>& protos):
+        types_(types), protos_(protos) {}
+
+    // nullopt when the exec has a node or a type the interpreter does not run
+    std::optional<Plan> prepare(const FunctionNode& exec);
+    // the answer of a prepared exec, once every callee of its plan has a bridge
+    Value run(const FunctionNode& exec);
+
+    [[nodiscard]] bool has_bridge(Symbol callee) const { return bridges_.contains(callee); }
+    void add_bridge(Symbol callee, Bridge bridge);
+    // callee was declared again, its bridge calls the old declaration
+    void forget_bridge(Symbol callee) { bridges_.erase(callee); }
+private:
+    using Locals = std::vector<std::pair<Symbol, TypeId>>;
+
+    // the type of the value of e, uninit when it has none
+    std::optional<TypeId> prepare(const Expression* e, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare(const Body& body, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare_node(const ArrayExpr& e, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare_node(const LiteralExpr& e, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare_node(const VariableExpr& e, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare_node(const BinaryExpr& e, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare_node(const CallExpr& e, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare_node(const IfExpr& e, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare_node(const ForExpr& e, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare_node(const UnaryExpr& e, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare_node(const VarDeclareExpr& e, Locals& locals, Plan& plan);
+    std::optional<TypeId> prepare_node(const ReturnExpr& e, Locals& locals, Plan& plan);
+    // the answer type of a call of callee with these argument types
+    std::optional<TypeId> prepare_call(Symbol callee, const std::vector<TypeId>& args, Plan& plan);
+    std::optional<TypeId> scalar_type(Symbol name);
+
+    Value eval(const Expression* e);
+    Value eval(const Body& body);
+    Value eval_node(const ArrayExpr& e);
+    Value eval_node(const LiteralExpr& e);
+    Value eval_node(const VariableExpr& e);
+    Value eval_node(const BinaryExpr& e);
+    Value eval_node(const CallExpr& e);
+    Value eval_node(const IfExpr& e);
+    Value eval_node(const ForExpr& e);
+    Value eval_node(const UnaryExpr& e);
+    Value eval_node(const VarDeclareExpr& e);
+    Value eval_node(const ReturnExpr& e);
+    Value call(Symbol callee, llvm::ArrayRef<Value> args);
+    Value& local(Symbol name);
+
+    TypeManager& types_;
+    const std::unordered_map<Symbol, ProtoType>& protos_;
+    std::unordered_map<Symbol, std::pair<Bridge, TypeId>> bridges_; // with the answer type of the callee
+
+    std::vector<std::pair<Symbol, Value>> locals_; // innermost last, a for loop pops its variable
+    Value answer_;
+    bool returned_ = false;
+};
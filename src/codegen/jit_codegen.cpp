@@ -1,43 +1,535 @@
 #include "jit_codegen.hpp"
 #include "codegen/codegen.hpp"
-#include <llvm/Transforms/InstCombine/InstCombine.h>
-#include <llvm/Transforms/Scalar.h>
-#include <llvm/Transforms/Scalar/GVN.h>
-#include <llvm/Transforms/Utils.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <string>
 
-JitCodeGenerator::JitCodeGenerator(llvm::raw_ostream& os, CodeGeneratorSetting setting): CodeGenerator(os, setting, false) {
+namespace {
+
+/// ExecKey writes an exec out as bytes, which are equal for two execs only when they lower to the
+/// same code: the checked ast with what the TypeChecker resolved, and for every name of a top
+/// level item the generation of its definition.
+class ExecKey {
+public:
+    explicit ExecKey(const std::unordered_map<Symbol, uint64_t>& generations): generations_(generations) {}
+
+    std::string of(const FunctionNode& f) {
+        put_defined(f.prototype->answer);
+        put(f.body);
+        return std::move(key_);
+    }
+private:
+    template<typename T>
+    void put_bytes(const T& value) {
+        key_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void put(Symbol name) { put_bytes(name.id); }
+
+    void put_defined(Symbol name) {
+        put(name);
+        auto generation = generations_.find(name);
+        put_bytes(generation == generations_.end() ? uint64_t(0) : generation->second);
+    }
+
+    void put(const Body& body) {
+        put_bytes(body.has_return_value);
+        put_bytes(body.data.size());
+        for (auto e: body.data) {
+            put(e);
+        }
+    }
+
+    void put(std::span<ExpressionPtr> expressions) {
+        put_bytes(expressions.size());
+        for (auto e: expressions) {
+            put(e);
+        }
+    }
+
+    void put(const Expression* e) {
+        if (!e) {
+            put_bytes(uint8_t(0xff));
+            return;
+        }
+        put_bytes(e->kind);
+        visit_expression(e, [&](const auto* node) { put_node(*node); });
+    }
+
+    void put_node(const ArrayExpr& e) {
+        put(e.elements);
+        put_defined(e.type);
+        put_bytes(e.type_id);
+    }
+    void put_node(const LiteralExpr& e) {
+        put_bytes(e.value);
+        put(e.type);
+        put_bytes(e.type_id);
+    }
+    void put_node(const VariableExpr& e) {
+        put(e.name);
+        put_bytes(e.is_array_offset);
+        put_bytes(e.addrs.size());
+        for (auto& addr: e.addrs) {
+            put_bytes(addr.index());
+            if (auto field = std::get_if<VariableExpr::Field>(&addr)) {
+                put(field->name);
+                put_bytes(field->index);
+            } else {
+                put(std::get<ExpressionPtr>(addr));
+            }
+        }
+    }
+    void put_node(const BinaryExpr& e) {
+        put_defined(e.oper);
+        put(e.lhs);
+        put(e.rhs);
+    }
+    void put_node(const CallExpr& e) {
+        put_defined(e.callee);
+        put_bytes(e.conversion);
+        put(e.args);
+    }
+    void put_node(const IfExpr& e) {
+        put(e.condition);
+        put(e.then);
+        put(e._else);
+    }
+    void put_node(const ForExpr& e) {
+        put(e.var_name);
+        put_bytes(e.type_id);
+        put(e.start);
+        put(e.end);
+        put(e.step);
+        put(e.body);
+    }
+    void put_node(const UnaryExpr& e) {
+        put_defined(e._operater);
+        put(e.operand);
+    }
+    void put_node(const VarDeclareExpr& e) {
+        put_defined(e.type);
+        put(e.name);
+        put_bytes(e.is_const);
+        put_bytes(e.type_id);
+        put(e.value);
+    }
+    void put_node(const ReturnExpr& e) {
+        put(e.ret);
+    }
+
+    const std::unordered_map<Symbol, uint64_t>& generations_;
+    std::string key_;
+};
+
+// whether an exec runs a for loop, which makes its thunk worth optimizing
+bool has_loop(const Expression* e);
+
+bool has_loop(std::span<const ExpressionPtr> expressions) {
+    return std::any_of(expressions.begin(), expressions.end(), [](auto e) { return has_loop(e); });
+}
+
+bool has_loop(const Expression* e) {
+    if (!e) {
+        return false;
+    }
+    return visit_expression(e, overloaded{
+        [](const ForExpr*) { return true; },
+        [](const ArrayExpr* node) { return has_loop(node->elements); },
+        [](const LiteralExpr*) { return false; },
+        [](const VariableExpr* node) {
+            return std::any_of(node->addrs.begin(), node->addrs.end(), [](auto& addr) {
+                auto index = std::get_if<ExpressionPtr>(&addr);
+                return index && has_loop(*index);
+            });
+        },
+        [](const BinaryExpr* node) { return has_loop(node->lhs) || has_loop(node->rhs); },
+        [](const CallExpr* node) { return has_loop(node->args); },
+        [](const IfExpr* node) {
+            return has_loop(node->condition) || has_loop(node->then.data) || has_loop(node->_else.data);
+        },
+        [](const UnaryExpr* node) { return has_loop(node->operand); },
+        [](const VarDeclareExpr* node) { return has_loop(node->value); },
+        [](const ReturnExpr* node) { return has_loop(node->ret); },
+    });
+}
+
+}  // namespace
+
+JitCodeGenerator::JitCodeGenerator(llvm::raw_ostream& os, CodeGeneratorSetting setting): CodeGenerator(os, setting, false),
+    interpreter_(type_manager_, function_protos_) {
     exit_on_error_ = llvm::ExitOnError();
-    jit_ = exit_on_error_(OrcJitEngine::create());
+    if (setting_.tiered_compile) {
+        // baselines are compiled as they are defined, only hot functions see the optimizer, and at O3
+        setting_.lazy_compile = false;
+        setting_.opt_level = OptLevel::O3;
+    }
+    // the engine runs the module pipeline on every module it compiles, its inliner simplifies each
+    // function already, a pass at lowering time would only do that work twice
+    setting_.function_pass_optimize = false;
+    jit_ = exit_on_error_(OrcJitEngine::create(
+        setting_.target, setting_.opt_level, setting_.lazy_compile, setting_.compile_threads,
+        setting_.object_cache));
+    if (setting_.tiered_compile) {
+        tiers_ = std::make_unique<TieredCompiler>(*jit_, setting_.hot_call_threshold);
+    }
     initialize_llvm_elements();
 }
 
-void JitCodeGenerator::initialize_llvm_elements() {
-    context_ = std::make_unique<llvm::LLVMContext>();
+JitCodeGenerator::~JitCodeGenerator() {
+    release_execs();
+    while (!exec_cache_.empty()) {
+        evict_exec();
+    }
+}
+
+void JitCodeGenerator::print_tier_stats(llvm::raw_ostream& os) {
+    if (!tiers_) {
+        os << "tiered compilation is off\n";
+        return;
+    }
+    tiers_->print_stats(os);
+}
+
+void JitCodeGenerator::print_cache_stats(llvm::raw_ostream& os) {
+    if (setting_.object_cache.directory.empty()) {
+        os << "object cache is off\n";
+        return;
+    }
+    jit_->print_cache_stats(os);
+}
+
+void JitCodeGenerator::compile_definitions() {
+    if (tiers_) {
+        exit_on_error_(tiers_->compile_pending());
+    } else if (!uncompiled_.empty()) {
+        auto names = std::move(uncompiled_);
+        uncompiled_.clear();
+        if (auto symbols = jit_->lookup_all(names); !symbols) {
+            output_stream_ << llvm::toString(symbols.takeError()) << '\n';
+        }
+    }
+}
+
+void JitCodeGenerator::wait_for_tier_up() {
+    if (tiers_) {
+        tiers_->wait_idle();
+    }
+}
+
+void JitCodeGenerator::initialize_llvm_elements(bool exec) {
+    module_.reset();
+    if (!exec) {
+        context_owner_ = llvm::orc::ThreadSafeContext(std::make_unique<llvm::LLVMContext>());
+        context_ = context_owner_.getContext();
+        type_manager_.forget_llvm_types();
+    } else {
+        if (!exec_context_.getContext() || exec_context_uses_ == exec_context_reuses) {
+            exec_context_ = llvm::orc::ThreadSafeContext(std::make_unique<llvm::LLVMContext>());
+            exec_context_uses_ = 0;
+            type_manager_.forget_llvm_types();
+        }
+        exec_context_uses_++;
+        exec_lock_.emplace(exec_context_.getLock());
+        context_ = exec_context_.getContext();
+    }
     module_ = std::make_unique<llvm::Module>("my cool jit", *context_);
     module_->setDataLayout(jit_->get_data_layout());
+    builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);
+}
 
-    builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);    
-    if (setting_.function_pass_optimize) {
-        function_pass_manager_ = std::make_unique<llvm::legacy::FunctionPassManager>(module_.get());
+void JitCodeGenerator::lower_exec(const FunctionNode& f) {
+    if (pending_execs_.empty()) {
+        batch_start_ = std::chrono::steady_clock::now();
+    }
+    std::string key;
+    if (setting_.exec_cache_size > 0) {
+        key = ExecKey(generations_).of(f);
+        if (auto hit = exec_cache_index_.find(key); hit != exec_cache_index_.end()) {
+            exec_cache_hits_++;
+            exec_cache_.splice(exec_cache_.begin(), exec_cache_, hit->second);
+            pending_execs_.push_back(PendingExec {.answer = hit->second->answer, .address = hit->second->address});
+            return;
+        }
+        exec_cache_misses_++;
+    }
 
-        function_pass_manager_->add(llvm::createPromoteMemoryToRegisterPass());
-        function_pass_manager_->add(llvm::createInstructionCombiningPass());
-        function_pass_manager_->add(llvm::createReassociatePass());
-        // function_pass_manager_->add(llvm::createGVNPass());
-        function_pass_manager_->add(llvm::createCFGSimplificationPass());
-    
-        function_pass_manager_->doInitialization();
+    bool loops = has_loop(f.body.data);
+    if (exec_module_open_ && loops != exec_module_loops_) {
+        // a module goes to one compiler, so the thunks lowered before run first
+        run_execs();
+        batch_start_ = std::chrono::steady_clock::now();
+    }
+    if (!exec_module_open_) {
+        initialize_llvm_elements(true);
+        exec_module_open_ = true;
+        exec_module_loops_ = loops;
+    }
+    if (auto ir = CodeGenerator::codegen(f)) {
+        // unique, so the thunks share a module and several modules may stay until they are released together
+        std::string name = "__anon_expr." + std::to_string(exec_thunks_++);
+        ir->setName(name);
+        // the TypeChecker made sure the answer type exists
+        auto answer = type_manager_.find_type_by_name(f.prototype->answer)->id;
+        pending_execs_.push_back(PendingExec {.name = name, .answer = answer, .key = std::move(key)});
+    } else {
+        pending_execs_.push_back(PendingExec {.err = err_});
+    }
+}
+
+void JitCodeGenerator::run_execs() {
+    if (pending_execs_.empty()) {
+        return;
+    }
+    auto pending = std::move(pending_execs_);
+    pending_execs_.clear();
+
+    std::vector<std::string> names;
+    size_t runs = 0;
+    for (auto& exec: pending) {
+        if (exec.err.empty()) {
+            runs++;
+            if (!exec.address) {
+                names.push_back(exec.name);
+            }
+        }
+    }
+    if (!names.empty()) {
+        compile_definitions();
+        if (!exec_modules_) {
+            exec_modules_ = std::make_shared<ExecModules>();
+            exec_modules_->tracker = jit_->get_main_jit_dylib().createResourceTracker();
+        }
+        exit_on_error_(jit_->add_exec_module(
+            llvm::orc::ThreadSafeModule(std::move(module_), exec_context_), exec_modules_->tracker,
+            exec_module_loops_));
+        // the compile threads take the context from here on
+        builder_.reset();
+        exec_lock_.reset();
+        auto thunks = exit_on_error_(jit_->lookup_all(names));
+        auto thunk = thunks.begin();
+        for (auto& exec: pending) {
+            if (exec.err.empty() && !exec.address) {
+                exec.address = (thunk++)->getAddress();
+            }
+        }
+    }
+    module_.reset();
+    builder_.reset();
+    exec_lock_.reset();
+    exec_module_open_ = false;
+
+    // lowering and compiling is shared by the batch, each exec is charged its part of it and its own call
+    std::chrono::duration<double, std::micro> compiled = std::chrono::steady_clock::now() - batch_start_;
+    double share = runs > 0 ? compiled.count() / runs : 0;
+    auto timed = [&](auto thunk) {
+        auto start = std::chrono::steady_clock::now();
+        auto value = thunk();
+        std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - start;
+        record_exec_micros(share + took.count());
+        return value;
+    };
+    for (auto& exec: pending) {
+        if (!exec.err.empty()) {
+            output_stream_ << exec.err << '\n';
+            continue;
+        }
+        auto address = exec.address;
+        switch (exec.answer) {
+        case TypeSystem::BuiltinTypes::i32: {
+            auto functor_int = llvm::jitTargetAddressToPointer<int (*)()>(address);
+            output_stream_ << std::to_string(timed(functor_int)) << '\n';
+            break;
+        }
+        case TypeSystem::BuiltinTypes::f64: {
+            auto functor_double = llvm::jitTargetAddressToPointer<double (*)()>(address);
+            output_stream_ << std::to_string(timed(functor_double)) << '\n';
+            break;
+        }
+        case TypeSystem::BuiltinTypes::boolean: {
+            auto functor_bool = llvm::jitTargetAddressToPointer<bool (*)()>(address);
+            output_stream_ << (timed(functor_bool) ? "true" : "false") << '\n';
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // only once all ran, an eviction may remove the modules of a hit of this batch
+    for (auto& exec: pending) {
+        if (exec.err.empty() && !exec.key.empty()) {
+            cache_exec(std::move(exec.key), exec.address, exec.answer);
+        }
+    }
+
+    exec_tracked_ += names.size();
+    if (exec_tracked_ >= exec_batch) {
+        release_execs();
+    }
+}
+
+void JitCodeGenerator::record_exec_micros(double micros) {
+    auto index = exec_count_++;
+    if (exec_micros_.size() < exec_samples) {
+        exec_micros_.push_back(micros);
+    } else {
+        exec_micros_[index % exec_samples] = micros;
+    }
+}
+
+bool JitCodeGenerator::interpret_exec(const FunctionNode& f) {
+    if (setting_.exec_mode == ExecMode::Jit) {
+        return false;
+    }
+    auto plan = interpreter_.prepare(f);
+    if (!plan || (setting_.exec_mode == ExecMode::Auto && plan->loops)) {
+        return false;
+    }
+    // the compiled execs before it print first, and whatever they call happens first
+    run_execs();
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto callee: plan->callees) {
+        if (interpreter_.has_bridge(callee)) {
+            continue;
+        }
+        compile_definitions();
+        auto bridge = build_bridge(callee);
+        if (!bridge) {
+            output_stream_ << llvm::toString(bridge.takeError()) << '\n';
+            return true;
+        }
+        interpreter_.add_bridge(callee, *bridge);
+    }
+
+    auto value = interpreter_.run(f);
+    if (value.type == TypeSystem::BuiltinTypes::i32) {
+        output_stream_ << std::to_string(value.i32) << '\n';
+    } else if (value.type == TypeSystem::BuiltinTypes::f64) {
+        output_stream_ << std::to_string(value.f64) << '\n';
+    } else {
+        output_stream_ << (value.boolean ? "true" : "false") << '\n';
+    }
+
+    std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - start;
+    record_exec_micros(took.count());
+    exec_interpreted_++;
+    return true;
+}
+
+llvm::Expected<Interpreter::Bridge> JitCodeGenerator::build_bridge(Symbol callee) {
+    initialize_llvm_elements();
+    auto function = get_function(callee);
+    if (!function) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(), "no function " + std::string(callee.str()));
+    }
+
+    auto slots = llvm::Type::getInt64PtrTy(*context_);
+    auto bridge_type = llvm::FunctionType::get(builder_->getVoidTy(), {slots, slots}, false);
+    std::string name = "__kalei_bridge." + std::string(callee.str()) + "." + std::to_string(bridges_built_++);
+    auto bridge = llvm::Function::Create(bridge_type, llvm::Function::ExternalLinkage, name, module_.get());
+    builder_->SetInsertPoint(llvm::BasicBlock::Create(*context_, "entry", bridge));
+
+    // every value sits at the start of its 8 byte slot
+    std::vector<llvm::Value*> args;
+    for (unsigned i = 0; i < function->arg_size(); i++) {
+        auto type = function->getFunctionType()->getParamType(i);
+        auto slot = builder_->CreateConstInBoundsGEP1_64(builder_->getInt64Ty(), bridge->getArg(0), i);
+        args.push_back(builder_->CreateLoad(type, builder_->CreateBitCast(slot, type->getPointerTo())));
+    }
+    auto answer = builder_->CreateCall(function, args);
+    builder_->CreateStore(answer, builder_->CreateBitCast(bridge->getArg(1), answer->getType()->getPointerTo()));
+    builder_->CreateRetVoid();
+
+    if (auto err = jit_->add_module(llvm::orc::ThreadSafeModule(std::move(module_), context_owner_))) {
+        return std::move(err);
+    }
+    auto symbol = jit_->lookup(name);
+    if (!symbol) {
+        return symbol.takeError();
+    }
+    return llvm::jitTargetAddressToPointer<Interpreter::Bridge>(symbol->getAddress());
+}
+
+void JitCodeGenerator::release_execs() {
+    if (exec_modules_) {
+        exec_modules_->released = true;
+        if (exec_modules_->cached == 0) {
+            exit_on_error_(exec_modules_->tracker->remove());
+        }
+        exec_modules_ = nullptr;
+        exec_tracked_ = 0;
+    }
+}
+
+void JitCodeGenerator::redefine(Symbol name) {
+    generations_[name] = ++definition_count_;
+    interpreter_.forget_bridge(name);
+}
+
+void JitCodeGenerator::cache_exec(std::string key, llvm::JITTargetAddress address, TypeId answer) {
+    // the same exec twice in one batch misses both times
+    if (exec_cache_index_.contains(key)) {
+        return;
+    }
+    if (exec_cache_.size() == setting_.exec_cache_size) {
+        evict_exec();
+    }
+    exec_modules_->cached++;
+    exec_cache_.push_front(CachedExec {
+        .key = std::move(key), .address = address, .answer = answer, .modules = exec_modules_});
+    exec_cache_index_.emplace(exec_cache_.front().key, exec_cache_.begin());
+}
+
+void JitCodeGenerator::evict_exec() {
+    auto& last = exec_cache_.back();
+    exec_cache_index_.erase(last.key);
+    if (--last.modules->cached == 0 && last.modules->released) {
+        exit_on_error_(last.modules->tracker->remove());
+    }
+    exec_cache_.pop_back();
+}
+
+void JitCodeGenerator::print_exec_stats(llvm::raw_ostream& os) {
+    if (exec_micros_.empty()) {
+        os << "no exec run yet\n";
+        return;
+    }
+    auto samples = exec_micros_;
+    std::sort(samples.begin(), samples.end());
+    // nearest rank, so with fewer than 100 samples p99 is the max
+    auto percentile = [&](double p) {
+        return samples[std::min(samples.size() - 1, size_t(std::ceil(p * samples.size())) - 1)];
+    };
+    os << exec_count_ << " execs, latest " << samples.size() << " in microseconds: p50 "
+       << llvm::format("%.1f", percentile(0.5)) << ", p90 " << llvm::format("%.1f", percentile(0.9))
+       << ", p99 " << llvm::format("%.1f", percentile(0.99)) << ", max " << llvm::format("%.1f", samples.back())
+       << '\n';
+    if (setting_.exec_cache_size > 0) {
+        os << "exec cache: " << exec_cache_hits_ << " hits, " << exec_cache_misses_ << " misses, "
+           << exec_cache_.size() << " of " << setting_.exec_cache_size << " kept\n";
+    }
+    if (setting_.exec_mode != ExecMode::Jit) {
+        os << "interpreted " << exec_interpreted_ << " of " << exec_count_ << " execs\n";
     }
 }
 
 void JitCodeGenerator::codegen(std::vector<ASTNodePtr>&& ast_tree) {
     for (auto& ast: ast_tree) {
+        bool lowered = false;
         ast->match(
             [&](ExternNode& e) {
-                std::string name = e.prototype->name;
-                function_protos_[name] = *e.prototype;
-                if (auto ir = CodeGenerator::codegen(std::move(e.prototype))) {
+                // whatever it prints comes after the values of the execs before it
+                run_execs();
+                Symbol name = e.prototype->name;
+                redefine(name);
+                function_protos_[name] = e.prototype->copy_to(proto_arena_);
+                if (!module_) {
+                    initialize_llvm_elements();
+                }
+                if (auto ir = CodeGenerator::codegen(*e.prototype)) {
                     ir->print(output_stream_);
                 } else {
                     output_stream_ << err_ << '\n';
@@ -45,66 +537,67 @@ void JitCodeGenerator::codegen(std::vector<ASTNodePtr>&& ast_tree) {
                 }
             },
             [&](FunctionNode& f) {
-                bool is_top = f.prototype->name == "__anon_expr";
+                bool is_top = f.prototype->name == Symbols::anon_expr;
                 if (is_top) {
-                    auto result_type_name = f.prototype->answer;
-                    if (auto ir = CodeGenerator::codegen(f)) {
-                        auto rt = jit_->get_main_jit_dylib().createResourceTracker();
-                        auto tsm = llvm::orc::ThreadSafeModule(
-                            std::move(module_),
-                        std::move(context_)
-                        );
-                        exit_on_error_(jit_->add_module(std::move(tsm), rt));
-                        initialize_llvm_elements();
-
-                        auto expr_symbol = exit_on_error_(jit_->lookup("__anon_expr"));
-                        auto address = expr_symbol.getAddress();
-                        if (result_type_name == "i32") {
-                            auto functor_int = llvm::jitTargetAddressToPointer<int (*)()>(address);
-                            output_stream_ << std::to_string(functor_int()) << '\n';
-                        } else if (result_type_name == "double") {
-                            auto functor_double = llvm::jitTargetAddressToPointer<double (*)()>(address);
-                            output_stream_ << std::to_string(functor_double()) << '\n';
+                    if (!interpret_exec(f)) {
+                        lower_exec(f);
+                        if (!setting_.batch_execs || pending_execs_.size() == exec_batch) {
+                            run_execs();
                         }
-
-                        exit_on_error_(rt->remove());
-                    } else {
-                        output_stream_ << err_ << '\n';
                     }
                 } else {
+                    // earlier execs run first, against the definitions they were lowered with
+                    run_execs();
+                    redefine(f.prototype->name);
+                    initialize_llvm_elements();
                     if (auto ir = CodeGenerator::codegen(f)) {
                         if (setting_.print_ir) {
                             ir->print(output_stream_);
                         } else {
                             output_stream_ << "parsed function definition.\n";
                         }
-                        exit_on_error_(jit_->add_module(
-                            llvm::orc::ThreadSafeModule(std::move(module_),std::move(context_))
-                        ));
-                        initialize_llvm_elements();
+                        if (tiers_) {
+                            exit_on_error_(tiers_->add(*ir, std::move(module_), context_owner_));
+                        } else {
+                            exit_on_error_(jit_->add_module(
+                                llvm::orc::ThreadSafeModule(std::move(module_), context_owner_)
+                            ));
+                            if (setting_.compile_threads > 0 && !setting_.lazy_compile) {
+                                uncompiled_.push_back(std::string(f.prototype->name.str()));
+                            }
+                        }
+                        lowered = true;
                     } else {
                         output_stream_ << err_ << '\n';
                     }
                 }
             },
             [&](StructNode& s) {
+                run_execs();
+                redefine(s.name);
                 type_manager_.add_type(s.name, s.elements);
                 output_stream_ << "parsed struct definition.\n";
             }
         );
+        if (lowered) {
+            retain_function(std::move(ast));
+        }
     }
+    run_execs();
+    release_execs();
+    compile_definitions();
 }
 
-llvm::Value* JitCodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
+llvm::Value* JitCodeGenerator::codegen(const BinaryExpr& e) {
     // Special case '=' because we don't want to emit the LHS as an expression.
-    if (e->oper == "=") {
-        auto lhse = static_cast<VariableExpr*>(e->lhs.get());
+    if (e.oper == Symbols::assign) {
+        auto lhse = static_cast<const VariableExpr*>(e.lhs);
         if (!lhse) {
             err_ = "destination of '=' must be a variable";
             return nullptr;
         }
 
-        llvm::Value* rhs_value = CodeGenerator::codegen(std::move(e->rhs));
+        llvm::Value* rhs_value = CodeGenerator::codegen(e.rhs);
         if (!rhs_value) {
             return nullptr;
         }
@@ -114,7 +607,7 @@ llvm::Value* JitCodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
                 std::vector<llvm::Value*> offset_values {llvm::ConstantInt::get(*context_, llvm::APInt(32, 0))};
                 for (auto& index: lhse->addrs) {
                     auto& taked_index = std::get<ExpressionPtr>(index);
-                    if (auto offset_value = CodeGenerator::codegen(std::move(taked_index))) {
+                    if (auto offset_value = CodeGenerator::codegen(taked_index)) {
                         offset_values.push_back(offset_value);
                     } else {
                         return nullptr;
@@ -122,7 +615,7 @@ llvm::Value* JitCodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
                 }
 
                 if (!symbol_table_.store(builder_.get(), lhse->name, rhs_value, offset_values)) {
-                    err_ = "SymbolTable store " + lhse->name + "failed.";
+                    err_ = "SymbolTable store " + std::string(lhse->name.str()) + "failed.";
                     return nullptr;
                 }
             } else {
@@ -130,23 +623,23 @@ llvm::Value* JitCodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
                 for (auto& addr: lhse->addrs) {
                     if (std::holds_alternative<ExpressionPtr>(addr)) {
                         auto& taked_index = std::get<ExpressionPtr>(addr);
-                        if (auto offset_value = CodeGenerator::codegen(std::move(taked_index))) {
+                        if (auto offset_value = CodeGenerator::codegen(taked_index)) {
                             element_or_offsets.emplace_back(offset_value);
                         } else {
                             return nullptr;
                         }                        
                     } else {
-                        element_or_offsets.emplace_back(std::get<std::string>(addr));
+                        element_or_offsets.emplace_back(std::get<VariableExpr::Field>(addr).index);
                     }
                 }
-                if (!symbol_table_.store(builder_.get(), lhse->name, rhs_value, element_or_offsets, type_manager_)) {
-                    err_ = "SymbolTable store " + lhse->name + "failed.";
+                if (!symbol_table_.store(builder_.get(), lhse->name, rhs_value, element_or_offsets)) {
+                    err_ = "SymbolTable store " + std::string(lhse->name.str()) + "failed.";
                     return nullptr;
                 } 
             }
         } else {
             if (!symbol_table_.store(builder_.get(), lhse->name, rhs_value)) {
-                err_ = "SymbolTable store " + lhse->name + "failed.";
+                err_ = "SymbolTable store " + std::string(lhse->name.str()) + "failed.";
                 return nullptr;
             }            
         }
@@ -154,8 +647,8 @@ llvm::Value* JitCodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
         return rhs_value; // support a = (b = c);
     }
     
-    llvm::Value* l = CodeGenerator::codegen(std::move(e->lhs));
-    llvm::Value* r = CodeGenerator::codegen(std::move(e->rhs));
+    llvm::Value* l = CodeGenerator::codegen(e.lhs);
+    llvm::Value* r = CodeGenerator::codegen(e.rhs);
     if (!r || !l) {
         return nullptr;
     }
@@ -169,11 +662,11 @@ llvm::Value* JitCodeGenerator::codegen(std::unique_ptr<BinaryExpr> e) {
         return nullptr;
     }
 
-    if (operator_function_manager_.exist(type, e->oper)) {
-        auto f = operator_function_manager_.get_function(r->getType(), e->oper);
+    if (operator_function_manager_.exist(type, e.oper)) {
+        auto f = operator_function_manager_.get_function(r->getType(), e.oper);
         return f(builder_.get(), l, r);
     }
-    llvm::Function* f = get_function(e->oper);
+    llvm::Function* f = get_function(e.oper);
     assert(f && "binary operator not found!");
     llvm::Value* ops[2] = {l, r};
     return builder_->CreateCall(f, ops, "binop");
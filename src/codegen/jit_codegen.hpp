@@ -4,16 +4,111 @@
 #include "codegen.hpp"
 #include "jit_engine.hpp"
 #include "extern.hpp"
+#include "interpreter.hpp"
+#include "tiered_compiler.hpp"
 #include <llvm/IR/Value.h>
+#include <chrono>
+#include <list>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 class JitCodeGenerator: public CodeGenerator {
 public:
     explicit JitCodeGenerator(llvm::raw_ostream& os, CodeGeneratorSetting setting);
+    ~JitCodeGenerator() override;
 
     void codegen(std::vector<ASTNodePtr>&& ast_tree) override;
-    llvm::Value* codegen(std::unique_ptr<BinaryExpr> e) override;
-    void initialize_llvm_elements();
+    llvm::Value* codegen(const BinaryExpr& e) override;
+    // a new module for the next item; execs share a pooled context, definitions get one of their own
+    void initialize_llvm_elements(bool exec = false);
+
+    // the tier of every function, the threshold decides when they move up
+    void print_tier_stats(llvm::raw_ostream& os);
+    // blocks until the recompilations already triggered are done
+    void wait_for_tier_up();
+    void print_cache_stats(llvm::raw_ostream& os);
+    // percentiles of the time from lowering an exec to its printed value, over the latest execs;
+    // execs compiled in one batch share its time evenly. Also how often the exec cache had the exec,
+    // and how many execs were interpreted
+    void print_exec_stats(llvm::raw_ostream& os);
 private:
+    // the definitions lowered since the last call are compiled together, on the compile threads if any
+    void compile_definitions();
+    // lowers an anonymous function into the exec module under a name of its own, a thunk of the batch,
+    // unless the exec cache holds the same exec, which then runs without being lowered
+    void lower_exec(const FunctionNode& f);
+    // compiles the thunks lowered so far in one go, then runs them in order and prints their values
+    void run_execs();
+    // runs the exec in the interpreter when the exec mode picks it, false leaves it to be compiled
+    bool interpret_exec(const FunctionNode& f);
+    // void bridge(const uint64_t* args, uint64_t* answer) calling callee, for the interpreter
+    llvm::Expected<Interpreter::Bridge> build_bridge(Symbol callee);
+    // one exec took micros, its share of lowering and compiling included
+    void record_exec_micros(double micros);
+    // the modules of the execs run so far go in one removal, once none of their thunks is cached
+    void release_execs();
+    // a new definition of name, the cached execs which refer to it are not found anymore
+    void redefine(Symbol name);
+    void cache_exec(std::string key, llvm::JITTargetAddress address, TypeId answer);
+    void evict_exec();
+
+    static constexpr unsigned exec_context_reuses = 1024; // then constants it interned are let go
+    static constexpr unsigned exec_batch = 256;           // thunks in a module, and execs kept before they are released
+    static constexpr size_t exec_samples = 8192;
+
     std::unique_ptr<OrcJitEngine> jit_;    
+    std::vector<std::string> uncompiled_;
+    std::unique_ptr<TieredCompiler> tiers_; // only when tiered, stops before the engine goes
+
+    llvm::orc::ThreadSafeContext exec_context_;
+    // held while a batch is lowered, a compile thread may still be tearing down the module of the last
+    // batch in the same context
+    std::optional<llvm::orc::ThreadSafeContext::Lock> exec_lock_;
+    unsigned exec_context_uses_ = 0;
+    bool exec_module_open_ = false; // module_ holds the thunks of pending execs
+    bool exec_module_loops_ = false; // and they run loops, only such thunks share the module
+    uint64_t exec_thunks_ = 0;      // lowered so far, names them
+    uint64_t exec_count_ = 0;       // run so far, cached, interpreted or not
+    uint64_t exec_interpreted_ = 0;
+    std::vector<double> exec_micros_; // a ring of the latest exec_samples
+
+    // the modules of several batches under one tracker, removed once released and no thunk of theirs is cached
+    struct ExecModules {
+        llvm::orc::ResourceTrackerSP tracker;
+        unsigned cached = 0;
+        bool released = false;
+    };
+    std::shared_ptr<ExecModules> exec_modules_;
+    unsigned exec_tracked_ = 0;
+
+    struct PendingExec {
+        std::string name;
+        TypeId answer = TypeSystem::BuiltinTypes::uninit;
+        std::string err;                   // lowering failed, printed in its place
+        std::string key;                    // to cache the thunk under, empty when it came from the cache
+        llvm::JITTargetAddress address = 0; // set by a cache hit, or once the batch is compiled
+    };
+    std::vector<PendingExec> pending_execs_;
+    std::chrono::steady_clock::time_point batch_start_;
+
+    // the exec cache, keyed by the checked ast of the exec and the generations of the definitions it names
+    struct CachedExec {
+        std::string key;
+        llvm::JITTargetAddress address;
+        TypeId answer;
+        std::shared_ptr<ExecModules> modules;
+    };
+    std::list<CachedExec> exec_cache_; // the most recently run first
+    std::unordered_map<std::string_view, std::list<CachedExec>::iterator> exec_cache_index_;
+    std::unordered_map<Symbol, uint64_t> generations_; // of each defined name, from definition_count_
+    uint64_t definition_count_ = 0;
+    uint64_t exec_cache_hits_ = 0;
+    uint64_t exec_cache_misses_ = 0;
+
+    Interpreter interpreter_;
+    uint64_t bridges_built_ = 0; // names them, a failed one stays defined
 };
\ No newline at end of file
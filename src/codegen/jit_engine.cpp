@@ -1,27 +1,133 @@
 #include "jit_engine.hpp"
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/JITLink/EHFrameSupport.h>
+#include <cassert>
+#include <cstdlib>
+#include <llvm/Support/raw_ostream.h>
 #include <memory>
 
+namespace {
+
+// a stub jumps here when compiling the function behind it failed, there is no way to carry on
+void lazy_compile_failed() {
+    llvm::errs() << "lazy compilation of a jit function failed\n";
+    std::exit(1);
+}
+
+llvm::orc::JITTargetMachineBuilder baseline_of(const llvm::orc::JITTargetMachineBuilder& builder) {
+    auto baseline = builder;
+    baseline.setCodeGenOptLevel(llvm::CodeGenOpt::None);
+    baseline.getOptions().EnableFastISel = true;
+    return baseline;
+}
+
+// everything besides the module which decides the object a compiler makes of it
+std::string cache_salt(const llvm::orc::JITTargetMachineBuilder& builder, llvm::CodeGenOpt::Level level) {
+    std::string salt;
+    llvm::raw_string_ostream stream(salt);
+    stream << LLVM_VERSION_STRING << ';' << builder.getTargetTriple().str() << ';' << builder.getCPU() << ';'
+           << builder.getFeatures().getString() << ';' << static_cast<int>(level) << ';'
+           << builder.getOptions().EnableFastISel << ';' << static_cast<int>(*builder.getRelocationModel()) << ';'
+           << static_cast<int>(*builder.getCodeModel()) << ';';
+    return stream.str();
+}
+
+std::unique_ptr<DiskObjectCache> make_cache(const ObjectCacheSetting& cache,
+                                            const llvm::orc::JITTargetMachineBuilder& builder,
+                                            llvm::CodeGenOpt::Level level) {
+    if (cache.directory.empty()) {
+        return nullptr;
+    }
+    return std::make_unique<DiskObjectCache>(cache, cache_salt(builder, level));
+}
+
+}  // namespace
+
+void ThreadPoolDispatcher::dispatch(std::unique_ptr<llvm::orc::Task> task) {
+    // the pool takes copyable functions only
+    std::shared_ptr<llvm::orc::Task> shared(std::move(task));
+    pool_.async([shared]() { shared->run(); });
+}
+
+void ThreadPoolDispatcher::shutdown() {
+    pool_.wait();
+}
+
 OrcJitEngine::OrcJitEngine(
     std::unique_ptr<llvm::orc::ExecutionSession> es,
     llvm::orc::JITTargetMachineBuilder jtmb,
-    llvm::DataLayout dl
+    llvm::DataLayout dl,
+    OptLevel opt_level,
+    bool lazy,
+    const ObjectCacheSetting& cache
 ):  execution_session_(std::move(es)), 
+    target_machine_(llvm::cantFail(jtmb.createTargetMachine())),
+    machine_builder_(jtmb),
     layout_(std::move(dl)), 
     mangle_(*this->execution_session_, this->layout_),
-    object_layer_(*this->execution_session_, 
-                    []() {return std::make_unique<llvm::SectionMemoryManager>();}),
+    object_layer_(*this->execution_session_, std::make_unique<SlabMemoryManager>()),
+    baseline_object_cache_(make_cache(cache, baseline_of(jtmb), llvm::CodeGenOpt::None)),
+    object_cache_(make_cache(cache, jtmb, codegen_opt_level(opt_level))),
+    baseline_compiler_layer_(*this->execution_session_,
+                    object_layer_,
+                    std::make_unique<llvm::orc::ConcurrentIRCompiler>(baseline_of(jtmb), baseline_object_cache_.get())),
     compiler_layer_(*this->execution_session_, 
                     object_layer_,
-                    std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(jtmb))),
+                    std::make_unique<llvm::orc::ConcurrentIRCompiler>(jtmb, object_cache_.get())),
+    exec_compiler_layer_(*this->execution_session_,
+                    object_layer_,
+                    std::make_unique<llvm::orc::TMOwningSimpleCompiler>(
+                        llvm::cantFail(baseline_of(jtmb).createTargetMachine()))),
+    exec_loop_compiler_layer_(*this->execution_session_,
+                    object_layer_,
+                    std::make_unique<llvm::orc::TMOwningSimpleCompiler>(
+                        llvm::cantFail(jtmb.createTargetMachine()))),
+    exec_loop_optimize_layer_(*this->execution_session_, exec_loop_compiler_layer_),
+    optimize_layer_(*this->execution_session_, compiler_layer_),
+    opt_level_(opt_level),
     main_jit_dylib_(this->execution_session_->createBareJITDylib("<main>")) {
     main_jit_dylib_.addGenerator(
         llvm::cantFail(
             llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(layout_.getGlobalPrefix())
         )
     );
-    if (jtmb.getTargetTriple().isOSBinFormatCOFF()) {
-        object_layer_.setOverrideObjectFlagsWithResponsibilityFlags(true);
-        object_layer_.setAutoClaimResponsibilityForObjectSymbols(true);
+    // unwinders and debuggers find jitted frames, as they did with the section memory manager
+    object_layer_.addPlugin(std::make_unique<llvm::orc::EHFrameRegistrationPlugin>(
+        *execution_session_, std::make_unique<llvm::jitlink::InProcessEHFrameRegistrar>()));
+
+    optimize_layer_.setTransform([this](llvm::orc::ThreadSafeModule tsm, llvm::orc::MaterializationResponsibility&)
+                                 -> llvm::Expected<llvm::orc::ThreadSafeModule> {
+        // this may run on any compile thread, so with a target machine of its own
+        auto machine = machine_builder_.createTargetMachine();
+        if (!machine) {
+            return machine.takeError();
+        }
+        tsm.withModuleDo([&](llvm::Module& module) {
+            Optimizer(opt_level_, machine->get()).run(module);
+        });
+        return std::move(tsm);
+    });
+
+    exec_loop_optimize_layer_.setTransform([this](llvm::orc::ThreadSafeModule tsm, llvm::orc::MaterializationResponsibility&)
+                                           -> llvm::Expected<llvm::orc::ThreadSafeModule> {
+        // the lowering thread waits for the thunks meanwhile, so its target machine is free
+        tsm.withModuleDo([&](llvm::Module& module) {
+            Optimizer optimizer(opt_level_, target_machine_.get());
+            for (auto& function: module) {
+                if (!function.isDeclaration()) {
+                    optimizer.run(function);
+                }
+            }
+        });
+        return std::move(tsm);
+    });
+    if (lazy) {
+        auto& triple = target_machine_->getTargetTriple();
+        call_through_manager_ = llvm::cantFail(llvm::orc::createLocalLazyCallThroughManager(
+            triple, *execution_session_, llvm::pointerToJITTargetAddress(&lazy_compile_failed)));
+        compile_on_demand_layer_ = std::make_unique<llvm::orc::CompileOnDemandLayer>(
+            *execution_session_, optimize_layer_, *call_through_manager_,
+            llvm::orc::createLocalIndirectStubsManagerBuilder(triple));
     }
 }
 
@@ -39,13 +145,82 @@ llvm::orc::JITDylib& OrcJitEngine::get_main_jit_dylib() {
     return main_jit_dylib_;
 }
 
+llvm::TargetMachine* OrcJitEngine::get_target_machine() {
+    return target_machine_.get();
+}
+
 llvm::Error OrcJitEngine::add_module(llvm::orc::ThreadSafeModule tsm, llvm::orc::ResourceTrackerSP rt) {
     if (!rt) {
         rt = main_jit_dylib_.getDefaultResourceTracker();
     }
-    return compiler_layer_.add(rt, std::move(tsm));
+    if (compile_on_demand_layer_) {
+        return compile_on_demand_layer_->add(rt, std::move(tsm));
+    }
+    return optimize_layer_.add(rt, std::move(tsm));
+}
+
+llvm::Error OrcJitEngine::add_exec_module(llvm::orc::ThreadSafeModule tsm, llvm::orc::ResourceTrackerSP rt, bool loops) {
+    if (loops) {
+        return exec_loop_optimize_layer_.add(rt, std::move(tsm));
+    }
+    return exec_compiler_layer_.add(rt, std::move(tsm));
 }
 
 llvm::Expected<llvm::JITEvaluatedSymbol> OrcJitEngine::lookup(llvm::StringRef name) {
     return execution_session_->lookup({&main_jit_dylib_}, mangle_(name.str()));
-}
\ No newline at end of file
+}
+
+llvm::Expected<std::vector<llvm::JITEvaluatedSymbol>> OrcJitEngine::lookup_all(llvm::ArrayRef<std::string> names) {
+    llvm::orc::SymbolLookupSet symbols;
+    for (auto& name: names) {
+        symbols.add(mangle_(name));
+    }
+    auto found = execution_session_->lookup(llvm::orc::makeJITDylibSearchOrder({&main_jit_dylib_}), symbols);
+    if (!found) {
+        return found.takeError();
+    }
+
+    std::vector<llvm::JITEvaluatedSymbol> result;
+    result.reserve(names.size());
+    for (auto& name: names) {
+        result.push_back((*found)[mangle_(name)]);
+    }
+    return result;
+}
+
+void OrcJitEngine::print_cache_stats(llvm::raw_ostream& os) {
+    if (baseline_object_cache_) {
+        os << "baseline ";
+        baseline_object_cache_->print_stats(os);
+    }
+    if (object_cache_) {
+        object_cache_->print_stats(os);
+    }
+}
+
+llvm::Error OrcJitEngine::add_baseline_module(llvm::orc::ThreadSafeModule tsm) {
+    return baseline_compiler_layer_.add(main_jit_dylib_.getDefaultResourceTracker(), std::move(tsm));
+}
+
+llvm::Error OrcJitEngine::define_stub(llvm::StringRef name, llvm::JITTargetAddress target) {
+    if (!stubs_) {
+        stubs_ = llvm::orc::createLocalIndirectStubsManagerBuilder(target_machine_->getTargetTriple())();
+    }
+    auto flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+    if (auto err = stubs_->createStub(name, target, flags)) {
+        return err;
+    }
+    return define_absolute(name, stubs_->findStub(name, true).getAddress());
+}
+
+llvm::Error OrcJitEngine::redirect_stub(llvm::StringRef name, llvm::JITTargetAddress target) {
+    assert(stubs_ && "no stub defined yet");
+    return stubs_->updatePointer(name, target);
+}
+
+llvm::Error OrcJitEngine::define_absolute(llvm::StringRef name, llvm::JITTargetAddress address) {
+    auto flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+    return main_jit_dylib_.define(llvm::orc::absoluteSymbols({
+        {mangle_(name.str()), llvm::JITEvaluatedSymbol(address, flags)}
+    }));
+}
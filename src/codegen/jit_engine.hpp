@@ -2,51 +2,128 @@
 
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
 #include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
 #include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/ExecutionEngine/Orc/IRTransformLayer.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
 #include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
-#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
-#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/ExecutionEngine/Orc/LazyReexports.h"
+#include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/Orc/TaskDispatch.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include "object_cache.hpp"
+#include "optimizer.hpp"
+#include "slab_memory_manager.hpp"
+#include "target.hpp"
 
 #include <memory>
+#include <string>
+#include <vector>
+
+/// ThreadPoolDispatcher runs the materialization tasks of a session, compiles mostly, on a fixed
+/// number of threads. Every module has a context of its own, so they do not wait on each other.
+class ThreadPoolDispatcher: public llvm::orc::TaskDispatcher {
+public:
+    explicit ThreadPoolDispatcher(unsigned threads): pool_(llvm::hardware_concurrency(threads)) {}
+
+    void dispatch(std::unique_ptr<llvm::orc::Task> task) override;
+    void shutdown() override;
+private:
+    llvm::ThreadPool pool_;
+};
 
+/// OrcJitEngine optimizes and compiles the modules added to it. Eagerly, a module is compiled
+/// when added. Lazily, each function is compiled on its first call, through a stub. Baseline
+/// modules skip the optimizer and get a fast instruction selector, for a tiered compiler on top.
 class OrcJitEngine {
 public:
     OrcJitEngine(
         std::unique_ptr<llvm::orc::ExecutionSession> es,
         llvm::orc::JITTargetMachineBuilder jtmb,
-        llvm::DataLayout dl
+        llvm::DataLayout dl,
+        OptLevel opt_level,
+        bool lazy,
+        const ObjectCacheSetting& cache
     );
 
     ~OrcJitEngine();
 
-    static llvm::Expected<std::unique_ptr<OrcJitEngine>> create() {
-        auto epc = llvm::orc::SelfExecutorProcessControl::Create();
+    // compile_threads 0 compiles on whichever thread looks a definition up first
+    static llvm::Expected<std::unique_ptr<OrcJitEngine>> create(
+        const TargetSelection& target, OptLevel opt_level, bool lazy = false, unsigned compile_threads = 0,
+        const ObjectCacheSetting& cache = {}) {
+        std::unique_ptr<llvm::orc::TaskDispatcher> dispatcher;
+        if (compile_threads > 0) {
+            dispatcher = std::make_unique<ThreadPoolDispatcher>(compile_threads);
+        }
+        auto epc = llvm::orc::SelfExecutorProcessControl::Create(nullptr, std::move(dispatcher));
         if (!epc) return epc.takeError();
         auto es = std::make_unique<llvm::orc::ExecutionSession>(std::move(*epc));
         llvm::orc::JITTargetMachineBuilder jtmb(es->getExecutorProcessControl().getTargetTriple());
+        select_target(jtmb, target, codegen_opt_level(opt_level));
+        // what jitlink expects, any reference may then be as far as the address space allows
+        jtmb.setRelocationModel(llvm::Reloc::PIC_);
+        jtmb.setCodeModel(llvm::CodeModel::Small);
         auto dl = jtmb.getDefaultDataLayoutForTarget();
         if (!dl) return dl.takeError();
-        return std::make_unique<OrcJitEngine>(std::move(es), std::move(jtmb), std::move(*dl));
+        return std::make_unique<OrcJitEngine>(std::move(es), std::move(jtmb), std::move(*dl), opt_level, lazy, cache);
     }
 
     const llvm::DataLayout& get_data_layout() const;
     llvm::orc::JITDylib& get_main_jit_dylib();
+    // configured like the compiling ones, for the cost models of the optimizer on the lowering thread
+    llvm::TargetMachine* get_target_machine();
 
     llvm::Error add_module(llvm::orc::ThreadSafeModule tsm, llvm::orc::ResourceTrackerSP rt = nullptr);
+    // for code which runs once and is removed again: no optimizer, no object cache, compiled like a
+    // baseline but on one target machine, so only one may be looked up at a time. Code with loops
+    // gets the function simplification pipeline and the codegen level of the other modules instead.
+    llvm::Error add_exec_module(llvm::orc::ThreadSafeModule tsm, llvm::orc::ResourceTrackerSP rt, bool loops = false);
+    // compiled right away at O0 and with fast isel, no module pipeline
+    llvm::Error add_baseline_module(llvm::orc::ThreadSafeModule tsm);
+
+    // name becomes a symbol which jumps to wherever its stub points, redirect_stub may move it later
+    llvm::Error define_stub(llvm::StringRef name, llvm::JITTargetAddress target);
+    llvm::Error redirect_stub(llvm::StringRef name, llvm::JITTargetAddress target);
+    // a host function or variable jitted code may refer to by name
+    llvm::Error define_absolute(llvm::StringRef name, llvm::JITTargetAddress address);
     llvm::Expected<llvm::JITEvaluatedSymbol> lookup(llvm::StringRef name);
+    // one lookup for all names, so their definitions are compiled side by side on the compile threads
+    llvm::Expected<std::vector<llvm::JITEvaluatedSymbol>> lookup_all(llvm::ArrayRef<std::string> names);
+
+    // hits and misses of the object cache, nothing when there is none
+    void print_cache_stats(llvm::raw_ostream& os);
 private:
     std::unique_ptr<llvm::orc::ExecutionSession> execution_session_;
     
+    std::unique_ptr<llvm::TargetMachine> target_machine_;
+    llvm::orc::JITTargetMachineBuilder machine_builder_; // target machines are not shared between threads
     llvm::DataLayout layout_;
     llvm::orc::MangleAndInterner mangle_;
-    llvm::orc::RTDyldObjectLinkingLayer object_layer_;
+    llvm::orc::ObjectLinkingLayer object_layer_; // jitlink, on the pages of a SlabMemoryManager
+    // one per compiler, as their objects differ for the same module
+    std::unique_ptr<DiskObjectCache> baseline_object_cache_;
+    std::unique_ptr<DiskObjectCache> object_cache_;
+    llvm::orc::IRCompileLayer baseline_compiler_layer_;
     llvm::orc::IRCompileLayer compiler_layer_;
+    llvm::orc::IRCompileLayer exec_compiler_layer_;
+    llvm::orc::IRCompileLayer exec_loop_compiler_layer_;
+    llvm::orc::IRTransformLayer exec_loop_optimize_layer_; // simplifies each function of a thunk module
+    llvm::orc::IRTransformLayer optimize_layer_; // runs the module pipeline right before compiling
+    OptLevel opt_level_;
+
+    // only when lazy, they put a stub in front of every function which compiles it on the first call
+    std::unique_ptr<llvm::orc::LazyCallThroughManager> call_through_manager_;
+    std::unique_ptr<llvm::orc::CompileOnDemandLayer> compile_on_demand_layer_;
+    std::unique_ptr<llvm::orc::IndirectStubsManager> stubs_; // made with the first define_stub
 
     llvm::orc::JITDylib& main_jit_dylib_;
 };
\ No newline at end of file
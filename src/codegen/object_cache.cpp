@@ -0,0 +1,106 @@
+#include "object_cache.hpp"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/SHA1.h>
+
+#include <chrono>
+
+namespace {
+
+// pruneCache only looks at files with this prefix, which half written files never have
+const char* const entry_prefix = "llvmcache-";
+
+}  // namespace
+
+DiskObjectCache::DiskObjectCache(const ObjectCacheSetting& setting, std::string salt)
+    : directory_(setting.directory), max_bytes_(setting.max_bytes), salt_(std::move(salt)) {
+    if (auto ec = llvm::sys::fs::create_directories(directory_)) {
+        llvm::errs() << "object cache " << directory_ << ": " << ec.message() << '\n';
+    }
+    prune();
+}
+
+std::string DiskObjectCache::path_of(const llvm::Module& module) const {
+    std::string key = salt_;
+    llvm::raw_string_ostream stream(key);
+    llvm::WriteBitcodeToFile(module, stream);
+    stream.flush();
+
+    llvm::SmallString<128> path(directory_);
+    llvm::sys::path::append(path, entry_prefix + llvm::toHex(llvm::SHA1::hash(llvm::arrayRefFromStringRef(key)), true));
+    return std::string(path);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> DiskObjectCache::getObject(const llvm::Module* module) {
+    auto path = path_of(*module);
+    int fd;
+    if (llvm::sys::fs::openFileForRead(path, fd)) {
+        misses_++;
+        return nullptr;
+    }
+    auto buffer = llvm::MemoryBuffer::getOpenFile(llvm::sys::fs::convertFDToNativeFile(fd), path, -1);
+    // pruning drops the least recently used objects first, so a hit counts as a use
+    llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    if (!buffer) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    return std::move(*buffer);
+}
+
+void DiskObjectCache::notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) {
+    auto path = path_of(*module);
+    llvm::SmallString<128> temporary;
+    int fd;
+    if (llvm::sys::fs::createUniqueFile(directory_ + "/tmp-%%%%%%%%", fd, temporary)) {
+        return;
+    }
+    {
+        llvm::raw_fd_ostream stream(fd, true);
+        stream << object.getBuffer();
+        if (stream.has_error()) {
+            stream.clear_error();
+            llvm::sys::fs::remove(temporary);
+            return;
+        }
+    }
+    // readers see either no file or a whole one
+    if (llvm::sys::fs::rename(temporary, path)) {
+        llvm::sys::fs::remove(temporary);
+        return;
+    }
+    stores_++;
+
+    bool full;
+    {
+        std::lock_guard lock(prune_mutex_);
+        unpruned_bytes_ += object.getBufferSize();
+        full = unpruned_bytes_ > max_bytes_ / 8;
+    }
+    if (full) {
+        prune();
+    }
+}
+
+void DiskObjectCache::prune() {
+    std::lock_guard lock(prune_mutex_);
+    llvm::CachePruningPolicy policy;
+    policy.Interval = std::chrono::seconds(0);
+    policy.MaxSizeBytes = max_bytes_;
+    policy.MaxSizePercentageOfAvailableSpace = 0;
+    llvm::pruneCache(directory_, policy);
+    unpruned_bytes_ = 0;
+}
+
+void DiskObjectCache::print_stats(llvm::raw_ostream& os) const {
+    os << "object cache " << directory_ << ": " << hits_ << " hits, " << misses_ << " misses, "
+       << stores_ << " stored\n";
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/// ObjectCacheSetting places the objects of jitted modules on disk, so a later run loads them back.
+struct ObjectCacheSetting {
+    std::string directory;                // empty disables the cache
+    uint64_t max_bytes = uint64_t(256) << 20; // the oldest objects are pruned past this
+};
+
+/// DiskObjectCache keeps one file per compiled module, named by a hash of its optimized ir and
+/// of how it was compiled. Files are written under a temporary name and renamed into place, so
+/// several processes, or the compile threads of one, may share a directory.
+class DiskObjectCache: public llvm::ObjectCache {
+public:
+    // salt covers whatever else decides the object, like the cpu and the codegen options
+    DiskObjectCache(const ObjectCacheSetting& setting, std::string salt);
+
+    void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) override;
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+    [[nodiscard]] uint64_t hits() const { return hits_; }
+    [[nodiscard]] uint64_t misses() const { return misses_; }
+    void print_stats(llvm::raw_ostream& os) const;
+private:
+    std::string path_of(const llvm::Module& module) const;
+    void prune();
+
+    std::string directory_;
+    uint64_t max_bytes_;
+    std::string salt_;
+
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> stores_ = 0;
+    std::mutex prune_mutex_;
+    uint64_t unpruned_bytes_ = 0; // written since the last prune, guarded by prune_mutex_
+};
@@ -4,7 +4,7 @@
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 
-BinaryOperatorFunction OperatorFunctionManager::get_function(llvm::Type* type, std::string& op) {
+BinaryOperatorFunction OperatorFunctionManager::get_function(llvm::Type* type, Symbol op) {
     if (type->getTypeID() == llvm::Type::StructTyID) {
         return get_function(type->getStructName(), op);
     } else {
@@ -12,16 +12,16 @@ BinaryOperatorFunction OperatorFunctionManager::get_function(llvm::Type* type, s
     }
 }
 
-BinaryOperatorFunction OperatorFunctionManager::get_function(llvm::Type::TypeID type_id, std::string& op) {
+BinaryOperatorFunction OperatorFunctionManager::get_function(llvm::Type::TypeID type_id, Symbol op) {
     return primitive_functions_[type_id][op];
 }
 
-BinaryOperatorFunction OperatorFunctionManager::get_function(llvm::StringRef struct_name, std::string& op) {
+BinaryOperatorFunction OperatorFunctionManager::get_function(llvm::StringRef struct_name, Symbol op) {
     assert(false && "Unimplement function! Why go to here?");
     return nullptr;
 }
 
-bool OperatorFunctionManager::exist(llvm::Type* type, std::string& op) {
+bool OperatorFunctionManager::exist(llvm::Type* type, Symbol op) {
     if (type->getTypeID() == llvm::Type::StructTyID) {
         return exist(type->getStructName(), op);
     } else {
@@ -29,7 +29,7 @@ bool OperatorFunctionManager::exist(llvm::Type* type, std::string& op) {
     }    
 }
 
-bool OperatorFunctionManager::exist(llvm::Type::TypeID type_id, std::string& op) {
+bool OperatorFunctionManager::exist(llvm::Type::TypeID type_id, Symbol op) {
     if (primitive_functions_.count(type_id)) {
         if (primitive_functions_[type_id].count(op)) {
             return true;
@@ -38,7 +38,7 @@ bool OperatorFunctionManager::exist(llvm::Type::TypeID type_id, std::string& op)
     return false;
 }
 
-bool OperatorFunctionManager::exist(llvm::StringRef struct_name, std::string& op) {
+bool OperatorFunctionManager::exist(llvm::StringRef struct_name, Symbol op) {
     std::string name(struct_name);
     if (struct_functions_.count(name)) {
         if (struct_functions_[name].count(op)) {
@@ -48,7 +48,7 @@ bool OperatorFunctionManager::exist(llvm::StringRef struct_name, std::string& op
     return false;
 }
 
-void OperatorFunctionManager::add_function(llvm::Type* type, std::string& op, llvm::Function* f) {
+void OperatorFunctionManager::add_function(llvm::Type* type, Symbol op, llvm::Function* f) {
     if (type->getTypeID() == llvm::Type::StructTyID) {
         add_function(type->getStructName(), op, f);
     } else {
@@ -56,7 +56,7 @@ void OperatorFunctionManager::add_function(llvm::Type* type, std::string& op, ll
     }    
 }
 
-void OperatorFunctionManager::add_function(llvm::Type::TypeID type_id, std::string& op, llvm::Function* f) {
+void OperatorFunctionManager::add_function(llvm::Type::TypeID type_id, Symbol op, llvm::Function* f) {
     auto functor =
         [f](llvm::IRBuilder<>* builder, llvm::Value* lhs, llvm::Value* rhs) -> llvm::Value* {
         llvm::Value* ops[2] = {lhs, rhs};
@@ -66,7 +66,7 @@ void OperatorFunctionManager::add_function(llvm::Type::TypeID type_id, std::stri
     //std::cout << "added " << op << std::endl;
 }
 
-void OperatorFunctionManager::add_function(llvm::StringRef struct_name, std::string& op, llvm::Function* f) {
+void OperatorFunctionManager::add_function(llvm::StringRef struct_name, Symbol op, llvm::Function* f) {
     assert(false && "Unimplement function! Why go to here?");
 }
 
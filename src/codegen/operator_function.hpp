@@ -12,6 +12,8 @@
 #include <unordered_map>
 #include <unordered_set>
 
+#include "ast/symbol.hpp"
+
 using BinaryOperatorFunction = std::function<llvm::Value*(
     llvm::IRBuilder<>*, llvm::Value*, llvm::Value*
 )>;
@@ -22,21 +24,21 @@ using ExtendedBinaryOperatorFunction = std::function<llvm::Value*(
 
 struct OperatorFunctionManager {
 public:
-    using BinaryOperatorFunctionTable = std::unordered_map<std::string, BinaryOperatorFunction>;
+    using BinaryOperatorFunctionTable = std::unordered_map<Symbol, BinaryOperatorFunction>;
 
-    BinaryOperatorFunction get_function(llvm::Type* type, std::string& op);
-    bool exist(llvm::Type* type, std::string& op);
+    BinaryOperatorFunction get_function(llvm::Type* type, Symbol op);
+    bool exist(llvm::Type* type, Symbol op);
 
-    void add_function(llvm::Type* type, std::string& op, llvm::Function* f);
+    void add_function(llvm::Type* type, Symbol op, llvm::Function* f);
 private:
-    BinaryOperatorFunction get_function(llvm::Type::TypeID type_id, std::string& op);
-    BinaryOperatorFunction get_function(llvm::StringRef struct_name, std::string& op);
+    BinaryOperatorFunction get_function(llvm::Type::TypeID type_id, Symbol op);
+    BinaryOperatorFunction get_function(llvm::StringRef struct_name, Symbol op);
 
-    bool exist(llvm::Type::TypeID type_id, std::string& op);
-    bool exist(llvm::StringRef struct_name, std::string& op);
+    bool exist(llvm::Type::TypeID type_id, Symbol op);
+    bool exist(llvm::StringRef struct_name, Symbol op);
 
-    void add_function(llvm::Type::TypeID type_id, std::string& op, llvm::Function* f);
-    void add_function(llvm::StringRef struct_name, std::string& op, llvm::Function* f);
+    void add_function(llvm::Type::TypeID type_id, Symbol op, llvm::Function* f);
+    void add_function(llvm::StringRef struct_name, Symbol op, llvm::Function* f);
 private:
     std::unordered_map<std::string, BinaryOperatorFunctionTable> struct_functions_;
 
@@ -44,29 +46,27 @@ private:
         {   
             llvm::Type::TypeID::DoubleTyID, {
                 {
-                    "+", 
+                    Symbol("+"), 
                     [](llvm::IRBuilder<>* builder, llvm::Value* lhs, llvm::Value* rhs) -> llvm::Value* {
                         return builder->CreateFAdd(lhs, rhs, "adddouble");
                     }
                 },
                 {
-                    "-",
+                    Symbol("-"),
                     [](llvm::IRBuilder<>* builder, llvm::Value* lhs, llvm::Value* rhs) -> llvm::Value* {
                         return builder->CreateFSub(lhs, rhs, "subdouble");
                     }
                 },
                 {
-                    "*",
+                    Symbol("*"),
                     [](llvm::IRBuilder<>* builder, llvm::Value* lhs, llvm::Value* rhs) -> llvm::Value* {
                         return builder->CreateFMul(lhs, rhs, "muldouble");
                     }
                 },
                 {
-                    "<",
+                    Symbol("<"),
                     [](llvm::IRBuilder<>* builder, llvm::Value* lhs, llvm::Value* rhs) -> llvm::Value* {
-                        lhs = builder->CreateFCmpULT(lhs, rhs);
-                        return builder->CreateUIToFP(
-                            lhs, llvm::Type::getDoubleTy(builder->getContext()), "ltdouble");
+                        return builder->CreateFCmpULT(lhs, rhs, "ltdouble");
                     }
                 }
             }
@@ -74,28 +74,27 @@ private:
         {
             llvm::Type::TypeID::IntegerTyID, {
                 {
-                    "+", 
+                    Symbol("+"), 
                     [](llvm::IRBuilder<>* builder, llvm::Value* lhs, llvm::Value* rhs) -> llvm::Value* {
                         return builder->CreateAdd(lhs, rhs, "addint");
                     }
                 },
                 {
-                    "-",
+                    Symbol("-"),
                     [](llvm::IRBuilder<>* builder, llvm::Value* lhs, llvm::Value* rhs) -> llvm::Value* {
                         return builder->CreateSub(lhs, rhs, "subint");
                     }
                 },
                 {
-                    "*",
+                    Symbol("*"),
                     [](llvm::IRBuilder<>* builder, llvm::Value* lhs, llvm::Value* rhs) -> llvm::Value* {
                         return builder->CreateMul(lhs, rhs, "mulint");
                     }
                 },
                 {
-                    "<",
+                    Symbol("<"),
                     [](llvm::IRBuilder<>* builder, llvm::Value* lhs, llvm::Value* rhs) -> llvm::Value* {
-                        lhs = builder->CreateICmpULT(lhs, rhs, "ltint");
-                        return lhs;
+                        return builder->CreateICmpSLT(lhs, rhs, "ltint");
                     }
                 }
             }
@@ -0,0 +1,92 @@
+#include "optimizer.hpp"
+
+namespace {
+
+llvm::OptimizationLevel to_llvm_level(OptLevel level) {
+    switch (level) {
+    case OptLevel::O0: return llvm::OptimizationLevel::O0;
+    case OptLevel::O1: return llvm::OptimizationLevel::O1;
+    case OptLevel::O2: return llvm::OptimizationLevel::O2;
+    case OptLevel::O3: return llvm::OptimizationLevel::O3;
+    case OptLevel::Os: return llvm::OptimizationLevel::Os;
+    case OptLevel::Oz: return llvm::OptimizationLevel::Oz;
+    }
+    return llvm::OptimizationLevel::O2;
+}
+
+// the same choice clang makes: vectorize from O2 on, but not when squeezing for size
+llvm::PipelineTuningOptions tuning_options(OptLevel level) {
+    llvm::PipelineTuningOptions options;
+    bool vectorize = level == OptLevel::O2 || level == OptLevel::O3 || level == OptLevel::Os;
+    options.LoopVectorization = vectorize;
+    options.SLPVectorization = vectorize;
+    options.LoopUnrolling = level != OptLevel::O0 && level != OptLevel::Oz;
+    return options;
+}
+
+}  // namespace
+
+std::optional<OptLevel> parse_opt_level(std::string_view text) {
+    if (text.starts_with("-")) {
+        text.remove_prefix(1);
+    }
+    if (text.starts_with("O")) {
+        text.remove_prefix(1);
+    }
+    if (text == "0") return OptLevel::O0;
+    if (text == "1") return OptLevel::O1;
+    if (text == "2") return OptLevel::O2;
+    if (text == "3") return OptLevel::O3;
+    if (text == "s") return OptLevel::Os;
+    if (text == "z") return OptLevel::Oz;
+    return std::nullopt;
+}
+
+llvm::CodeGenOpt::Level codegen_opt_level(OptLevel level) {
+    switch (level) {
+    case OptLevel::O0: return llvm::CodeGenOpt::None;
+    case OptLevel::O1: return llvm::CodeGenOpt::Less;
+    case OptLevel::O2: return llvm::CodeGenOpt::Default;
+    case OptLevel::O3: return llvm::CodeGenOpt::Aggressive;
+    case OptLevel::Os: return llvm::CodeGenOpt::Default;
+    case OptLevel::Oz: return llvm::CodeGenOpt::Default;
+    }
+    return llvm::CodeGenOpt::Default;
+}
+
+Optimizer::Optimizer(OptLevel level, llvm::TargetMachine* target_machine)
+    : level_(level), builder_(target_machine, tuning_options(level)) {
+    builder_.registerModuleAnalyses(module_analyses_);
+    builder_.registerCGSCCAnalyses(cgscc_analyses_);
+    builder_.registerFunctionAnalyses(function_analyses_);
+    builder_.registerLoopAnalyses(loop_analyses_);
+    builder_.crossRegisterProxies(loop_analyses_, function_analyses_, cgscc_analyses_, module_analyses_);
+
+    auto llvm_level = to_llvm_level(level);
+    if (level == OptLevel::O0) {
+        // nothing to simplify per function, the module pipeline only keeps always-inline working
+        module_passes_ = builder_.buildO0DefaultPipeline(llvm_level);
+    } else {
+        function_passes_ = builder_.buildFunctionSimplificationPipeline(llvm_level, llvm::ThinOrFullLTOPhase::None);
+        module_passes_ = builder_.buildPerModuleDefaultPipeline(llvm_level);
+    }
+}
+
+void Optimizer::run(llvm::Function& function) {
+    if (level_ == OptLevel::O0) {
+        return;
+    }
+    function_passes_.run(function, function_analyses_);
+}
+
+void Optimizer::run(llvm::Module& module) {
+    module_passes_.run(module, module_analyses_);
+}
+
+void Optimizer::reset() {
+    // keyed by the address of the ir, which a later module may well reuse
+    loop_analyses_.clear();
+    function_analyses_.clear();
+    cgscc_analyses_.clear();
+    module_analyses_.clear();
+}
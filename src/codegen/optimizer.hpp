@@ -0,0 +1,46 @@
+#pragma once
+
+#include <llvm/Analysis/CGSCCPassManager.h>
+#include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Target/TargetMachine.h>
+#include <optional>
+#include <string_view>
+
+enum class OptLevel {O0, O1, O2, O3, Os, Oz};
+
+// "O2" or "2" style spellings, as on a compiler command line
+std::optional<OptLevel> parse_opt_level(std::string_view text);
+// the instruction selection and scheduling effort which goes with an opt level
+llvm::CodeGenOpt::Level codegen_opt_level(OptLevel level);
+
+/// Optimizer runs the new pass manager pipelines of one opt level over a single module: the
+/// function simplification pipeline on each function as it is generated, and the whole per-module
+/// pipeline (inliner, loop passes, vectorizers) once the module is complete. Analyses are cached
+/// for that module, reset() drops them before the Optimizer moves on to another one.
+class Optimizer {
+public:
+    // the target machine tunes the cost models of the vectorizers, nullptr leaves them generic
+    explicit Optimizer(OptLevel level, llvm::TargetMachine* target_machine = nullptr);
+
+    void run(llvm::Function& function);
+    void run(llvm::Module& module);
+    void reset();
+private:
+    OptLevel level_;
+
+    // declared in this order so the proxies in the module manager go first
+    llvm::LoopAnalysisManager loop_analyses_;
+    llvm::FunctionAnalysisManager function_analyses_;
+    llvm::CGSCCAnalysisManager cgscc_analyses_;
+    llvm::ModuleAnalysisManager module_analyses_;
+
+    llvm::PassBuilder builder_;
+    llvm::FunctionPassManager function_passes_;
+    llvm::ModulePassManager module_passes_;
+};
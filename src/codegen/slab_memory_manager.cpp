@@ -0,0 +1,177 @@
+#include "slab_memory_manager.hpp"
+
+#include <llvm/ExecutionEngine/JITLink/JITLink.h>
+#include <llvm/ExecutionEngine/Orc/Shared/AllocationActions.h>
+#include <llvm/Support/Process.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+/// InFlight is one link graph between its allocation and finalization. Standard and finalize
+/// segments share one range, the finalize part goes back as soon as the graph is finalized.
+class SlabMemoryManager::InFlight: public llvm::jitlink::JITLinkMemoryManager::InFlightAlloc {
+public:
+    InFlight(SlabMemoryManager& manager, llvm::jitlink::LinkGraph& graph, llvm::jitlink::BasicLayout layout,
+             char* base, size_t standard_size, size_t finalize_size)
+        : manager_(manager), graph_(graph), layout_(std::move(layout)),
+          base_(base), standard_size_(standard_size), finalize_size_(finalize_size) {}
+
+    void finalize(OnFinalizedFunction on_finalized) override {
+        for (auto& [group, segment]: layout_.segments()) {
+            auto size = llvm::alignTo(segment.ContentSize + segment.ZeroFillSize, manager_.page_size_);
+            if (size == 0) {
+                continue;
+            }
+            auto protection = llvm::jitlink::toSysMemoryProtectionFlags(group.getMemProt());
+            llvm::sys::MemoryBlock block(segment.WorkingMem, size);
+            if (auto ec = llvm::sys::Memory::protectMappedMemory(block, protection)) {
+                on_finalized(llvm::errorCodeToError(ec));
+                return;
+            }
+            if (protection & llvm::sys::Memory::MF_EXEC) {
+                llvm::sys::Memory::InvalidateInstructionCache(block.base(), block.allocatedSize());
+            }
+        }
+
+        auto dealloc_actions = llvm::orc::shared::runFinalizeActions(graph_.allocActions());
+        if (!dealloc_actions) {
+            on_finalized(dealloc_actions.takeError());
+            return;
+        }
+        if (auto err = manager_.give_back(base_ + standard_size_, finalize_size_)) {
+            on_finalized(std::move(err));
+            return;
+        }
+
+        auto finalized = new Finalized {
+            .block = llvm::sys::MemoryBlock(base_, standard_size_),
+            .dealloc_actions = std::move(*dealloc_actions),
+        };
+        on_finalized(FinalizedAlloc(llvm::orc::ExecutorAddr::fromPtr(finalized)));
+    }
+
+    void abandon(OnAbandonedFunction on_abandoned) override {
+        on_abandoned(manager_.give_back(base_, standard_size_ + finalize_size_));
+    }
+private:
+    SlabMemoryManager& manager_;
+    llvm::jitlink::LinkGraph& graph_;
+    llvm::jitlink::BasicLayout layout_;
+    char* base_;
+    size_t standard_size_;
+    size_t finalize_size_;
+};
+
+SlabMemoryManager::SlabMemoryManager(size_t slab_size)
+    : page_size_(llvm::sys::Process::getPageSizeEstimate()),
+      slab_size_(llvm::alignTo(slab_size, page_size_)) {}
+
+SlabMemoryManager::~SlabMemoryManager() {
+    for (auto& slab: slabs_) {
+        llvm::sys::Memory::releaseMappedMemory(slab);
+    }
+}
+
+void SlabMemoryManager::allocate(const llvm::jitlink::JITLinkDylib*, llvm::jitlink::LinkGraph& graph,
+                                 OnAllocatedFunction on_allocated) {
+    llvm::jitlink::BasicLayout layout(graph);
+    auto sizes = layout.getContiguousPageBasedLayoutSizes(page_size_);
+    if (!sizes) {
+        on_allocated(sizes.takeError());
+        return;
+    }
+
+    // one range for the whole graph, so every reference inside it stays in reach
+    auto base = take(sizes->total());
+    if (!base) {
+        on_allocated(base.takeError());
+        return;
+    }
+    char* next_standard = *base;
+    char* next_finalize = *base + sizes->StandardSegs;
+    for (auto& [group, segment]: layout.segments()) {
+        auto& next = group.getMemDeallocPolicy() == llvm::jitlink::MemDeallocPolicy::Standard
+            ? next_standard : next_finalize;
+        segment.WorkingMem = next;
+        segment.Addr = llvm::orc::ExecutorAddr::fromPtr(next);
+        next += llvm::alignTo(segment.ContentSize + segment.ZeroFillSize, page_size_);
+    }
+    if (auto err = layout.apply()) {
+        on_allocated(joinErrors(std::move(err), give_back(*base, sizes->total())));
+        return;
+    }
+
+    on_allocated(std::make_unique<InFlight>(
+        *this, graph, std::move(layout), *base, sizes->StandardSegs, sizes->FinalizeSegs));
+}
+
+void SlabMemoryManager::deallocate(std::vector<FinalizedAlloc> allocs, OnDeallocatedFunction on_deallocated) {
+    llvm::Error result = llvm::Error::success();
+    // the latest first, like their dealloc actions
+    for (auto iter = allocs.rbegin(); iter != allocs.rend(); ++iter) {
+        auto finalized = iter->release().toPtr<Finalized*>();
+        if (auto err = llvm::orc::shared::runDeallocActions(finalized->dealloc_actions)) {
+            result = joinErrors(std::move(result), std::move(err));
+        }
+        auto& block = finalized->block;
+        if (auto err = give_back(static_cast<char*>(block.base()), block.allocatedSize())) {
+            result = joinErrors(std::move(result), std::move(err));
+        }
+        delete finalized;
+    }
+    on_deallocated(std::move(result));
+}
+
+llvm::Expected<char*> SlabMemoryManager::take(size_t size) {
+    std::lock_guard lock(mutex_);
+    auto range = std::find_if(free_.begin(), free_.end(), [&](auto& free) { return free.second >= size; });
+    if (range == free_.end()) {
+        std::error_code ec;
+        auto slab = llvm::sys::Memory::allocateMappedMemory(
+            std::max(size, slab_size_), nullptr, llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_WRITE, ec);
+        if (ec) {
+            return llvm::errorCodeToError(ec);
+        }
+        slabs_.push_back(slab);
+        range = free_.emplace(static_cast<char*>(slab.base()), slab.allocatedSize()).first;
+    }
+
+    char* base = range->first;
+    size_t left = range->second - size;
+    free_.erase(range);
+    if (left > 0) {
+        free_.emplace(base + size, left);
+    }
+    // fresh pages are zero already, reused ones still hold the code of an earlier module
+    std::memset(base, 0, size);
+    return base;
+}
+
+llvm::Error SlabMemoryManager::give_back(char* base, size_t size) {
+    if (size == 0) {
+        return llvm::Error::success();
+    }
+    llvm::sys::MemoryBlock block(base, size);
+    if (auto ec = llvm::sys::Memory::protectMappedMemory(
+            block, llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_WRITE)) {
+        return llvm::errorCodeToError(ec);
+    }
+
+    std::lock_guard lock(mutex_);
+    auto [range, inserted] = free_.emplace(base, size);
+    assert(inserted && "range given back twice");
+    auto next = std::next(range);
+    if (next != free_.end() && range->first + range->second == next->first) {
+        range->second += next->second;
+        free_.erase(next);
+    }
+    if (range != free_.begin()) {
+        auto previous = std::prev(range);
+        if (previous->first + previous->second == range->first) {
+            previous->second += range->second;
+            free_.erase(range);
+        }
+    }
+    return llvm::Error::success();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/JITLink/JITLinkMemoryManager.h>
+#include <llvm/ExecutionEngine/Orc/Shared/WrapperFunctionUtils.h>
+#include <llvm/Support/Memory.h>
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/// SlabMemoryManager gives JITLink page ranges out of a few large mappings, and takes them back when
+/// a module goes away. Modules which live for one exec reuse the same pages, nothing is mapped or
+/// unmapped for them. Slabs are only unmapped with the manager.
+class SlabMemoryManager: public llvm::jitlink::JITLinkMemoryManager {
+public:
+    explicit SlabMemoryManager(size_t slab_size = size_t(16) << 20);
+    ~SlabMemoryManager() override;
+
+    void allocate(const llvm::jitlink::JITLinkDylib* dylib, llvm::jitlink::LinkGraph& graph,
+                  OnAllocatedFunction on_allocated) override;
+    using JITLinkMemoryManager::allocate;
+    void deallocate(std::vector<FinalizedAlloc> allocs, OnDeallocatedFunction on_deallocated) override;
+    using JITLinkMemoryManager::deallocate;
+private:
+    class InFlight;
+    struct Finalized {
+        llvm::sys::MemoryBlock block;
+        std::vector<llvm::orc::shared::WrapperFunctionCall> dealloc_actions;
+    };
+
+    // zeroed and read write, size a multiple of the page size
+    llvm::Expected<char*> take(size_t size);
+    // size as it was taken, the range turns read write again for the next one
+    llvm::Error give_back(char* base, size_t size);
+
+    size_t page_size_;
+    size_t slab_size_;
+    std::mutex mutex_;
+    std::vector<llvm::sys::MemoryBlock> slabs_;
+    std::map<char*, size_t> free_; // by start address, neighbours are merged
+};
@@ -8,140 +8,71 @@
 #include <llvm-15/llvm/IR/Value.h>
 #include <variant>
 
-void SymbolTable::back() {
-    variant_scoped_blocks_.pop_back();
-    constant_scoped_blocks_.pop_back();
+void SymbolTable::add_variant(Symbol name, llvm::AllocaInst* inst, bool by_address) {
+    bindings_.bind(name, Binding {inst, true, by_address});
 }
 
-void SymbolTable::step() {
-    variant_scoped_blocks_.emplace_back();
-    constant_scoped_blocks_.emplace_back();
+void SymbolTable::add_constant(Symbol name, llvm::Value* constant) {
+    bindings_.bind(name, Binding {constant, false, false});
 }
 
-void SymbolTable::add_variant(const std::string& name, llvm::AllocaInst* inst, const std::string& type) {
-    variant_scoped_blocks_.back().insert({name, {inst, type}});
-}
-
-void SymbolTable::add_constant(const std::string& name, llvm::Value* constant, const std::string& type) {
-    constant_scoped_blocks_.back().insert({name, {constant, type}});
-}
-
-llvm::Value* SymbolTable::load(llvm::IRBuilder<>* builder, const std::string& name) {
-    auto c_iter = constant_scoped_blocks_.rbegin();
-    for (auto iter = variant_scoped_blocks_.rbegin(); iter != variant_scoped_blocks_.rend(); iter++, c_iter++) {
-        if (iter->count(name)) {
-            auto [alloca, type] = (*iter)[name];
-            if (!type.empty()) {
-                return alloca;
-            }
-            return builder->CreateLoad(alloca->getAllocatedType(), alloca, "alloca");
-        }
-        if (c_iter->count(name)) {
-            return (*c_iter)[name].first;
-        }
+llvm::Value* SymbolTable::load(llvm::IRBuilder<>* builder, Symbol name) {
+    auto binding = bindings_.find(name);
+    if (!binding) {
+        return nullptr;
     }
-
-    return nullptr;
-}
-
-bool SymbolTable::store(llvm::IRBuilder<>* builder, const std::string& name, llvm::Value* target) {
-    auto c_iter = constant_scoped_blocks_.rbegin();
-    for (auto iter = variant_scoped_blocks_.rbegin(); iter != variant_scoped_blocks_.rend(); iter++, c_iter++) {
-        if (iter->count(name)) {
-            auto [alloca, type] = (*iter)[name];
-            builder->CreateStore(target, alloca);
-            return true;
-        }
-        if (c_iter->count(name)) {
-            return false;
-        }
+    if (!binding->is_variant || binding->by_address) {
+        return binding->value;
     }
-
-    return false;
+    auto alloca = static_cast<llvm::AllocaInst*>(binding->value);
+    return builder->CreateLoad(alloca->getAllocatedType(), alloca, "alloca");
 }
 
-bool SymbolTable::store(llvm::IRBuilder<>* builder, const std::string& name, llvm::Value* target, std::vector<llvm::Value*> offsets) {
-    auto c_iter = constant_scoped_blocks_.rbegin();
-    for (auto iter = variant_scoped_blocks_.rbegin(); iter != variant_scoped_blocks_.rend(); iter++, c_iter++) {
-        if (iter->count(name)) {
-            auto [alloca, type] = (*iter)[name];
-            auto addr = builder->CreateInBoundsGEP(alloca->getAllocatedType(), alloca, offsets, "addr");
-            builder->CreateStore(target, addr);
-            return true;
-        }
-        if (c_iter->count(name)) {
-            return false;
-        }
+bool SymbolTable::store(llvm::IRBuilder<>* builder, Symbol name, llvm::Value* target) {
+    auto binding = bindings_.find(name);
+    if (!binding || !binding->is_variant) {
+        return false;
     }
-
-    return false;    
+    builder->CreateStore(target, binding->value);
+    return true;
 }
 
-bool SymbolTable::store(llvm::IRBuilder<>* builder, const std::string& name, llvm::Value* target, std::vector<ElementOrOffset> addrs, TypeManager& type_manager) {
-    auto c_iter = constant_scoped_blocks_.rbegin();
-    for (auto iter = variant_scoped_blocks_.rbegin(); iter != variant_scoped_blocks_.rend(); iter++, c_iter++) {
-        if (iter->count(name)) {
-            auto& [alloca, type] = (*iter)[name];
-            auto front_end_type = type_manager.find_type_by_name(type);
-            auto front_end_type_raw = front_end_type.get();
-
-            llvm::Value* result_ptr = nullptr;
-            llvm::AllocaInst* target_ptr = alloca;
-            llvm::Type* target_type = alloca->getAllocatedType();
-
-            for (auto& addr: addrs) {
-                std::vector<llvm::Value*> offset_values {llvm::ConstantInt::get(builder->getContext(), llvm::APInt(32, 0))};
-                if (std::holds_alternative<llvm::Value*>(addr)) {
-                    if (auto arr = static_cast<TypeSystem::ArrayType*>(front_end_type_raw)) {
-                        front_end_type_raw = arr->element_type.get();
-                    } else {
-                        assert(false && "need array type in store");
-                    }
-                    auto& offset = std::get<llvm::Value*>(addr);
-                    offset_values.push_back(offset);
-                    result_ptr = builder->CreateInBoundsGEP(target_type, target_ptr, offset_values, "addr");
-                    target_type = front_end_type_raw->llvm_type(builder->getContext());
-                    target_ptr = static_cast<llvm::AllocaInst*>(result_ptr);
-                } else {
-                    auto element_name = std::get<std::string>(addr);
-                    if (auto aggr = static_cast<TypeSystem::AggregateType*>(front_end_type_raw)) {
-                        front_end_type_raw = aggr->element_type(element_name);
-                        auto element_index = aggr->element_position(element_name);
-                        offset_values.push_back(llvm::ConstantInt::get(builder->getContext(), llvm::APInt(32, element_index)));
-                        result_ptr = builder->CreateInBoundsGEP(target_type, target_ptr, offset_values, "addr");                    
-                        target_type = target_type->getStructElementType(element_index);
-                        target_ptr = static_cast<llvm::AllocaInst*>(result_ptr);
-                    } else {
-                        assert(false && "need array type in store");
-                    }
-                }
-            }
-            builder->CreateStore(target, result_ptr);
-
-            return true;
-        }
-        if (c_iter->count(name)) {
-            return false;
-        }
+bool SymbolTable::store(llvm::IRBuilder<>* builder, Symbol name, llvm::Value* target, std::vector<llvm::Value*> offsets) {
+    auto binding = bindings_.find(name);
+    if (!binding || !binding->is_variant) {
+        return false;
     }
-
-    return false;      
+    auto alloca = static_cast<llvm::AllocaInst*>(binding->value);
+    auto addr = builder->CreateInBoundsGEP(alloca->getAllocatedType(), alloca, offsets, "addr");
+    builder->CreateStore(target, addr);
+    return true;
 }
 
-std::string& SymbolTable::find_symbol_type_str(std::string& symbol_name) {
-    static std::string emp = "";
-    
-    auto c_iter = constant_scoped_blocks_.rbegin();
-    
-    for (auto iter = variant_scoped_blocks_.rbegin(); iter != variant_scoped_blocks_.rend(); iter++, c_iter++) {
-        if (iter->count(symbol_name)) {
-            return (*iter)[symbol_name].second;
-        }
-        if (c_iter->count(symbol_name)) {
-            return emp;
+bool SymbolTable::store(llvm::IRBuilder<>* builder, Symbol name, llvm::Value* target, std::vector<ElementOrOffset> addrs) {
+    auto binding = bindings_.find(name);
+    if (!binding || !binding->is_variant) {
+        return false;
+    }
+    auto alloca = static_cast<llvm::AllocaInst*>(binding->value);
+
+    llvm::Value* result_ptr = nullptr;
+    llvm::Value* target_ptr = alloca;
+    llvm::Type* target_type = alloca->getAllocatedType();
+
+    for (auto& addr: addrs) {
+        std::vector<llvm::Value*> offset_values {llvm::ConstantInt::get(builder->getContext(), llvm::APInt(32, 0))};
+        if (std::holds_alternative<llvm::Value*>(addr)) {
+            offset_values.push_back(std::get<llvm::Value*>(addr));
+            result_ptr = builder->CreateInBoundsGEP(target_type, target_ptr, offset_values, "addr");
+            target_type = target_type->getArrayElementType();
+        } else {
+            auto element_index = std::get<unsigned int>(addr);
+            offset_values.push_back(llvm::ConstantInt::get(builder->getContext(), llvm::APInt(32, element_index)));
+            result_ptr = builder->CreateInBoundsGEP(target_type, target_ptr, offset_values, "addr");                    
+            target_type = target_type->getStructElementType(element_index);
         }
+        target_ptr = result_ptr;
     }
-
-    return emp;    
+    builder->CreateStore(target, result_ptr);
+    return true;
 }
-
@@ -3,34 +3,44 @@
 #include <llvm-15/llvm/IR/Value.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Value.h>
-#include <unordered_map>
-#include <unordered_set>
+#include <cstdint>
 #include <variant>
 #include <vector>
 
+#include "ast/scoped_table.hpp"
+#include "ast/symbol.hpp"
 #include "ast/type.hpp"
+
+/// SymbolTable binds the names in scope to their allocas and constants, and loads and stores
+/// through them.
 class SymbolTable {
 public:
     SymbolTable() = default;
 
-    void step();
-    void back();
-    void add_variant(const std::string& name, llvm::AllocaInst* inst, const std::string& type = "");
-    void add_constant(const std::string& name, llvm::Value* constant, const std::string& type = "");
+    void step() { bindings_.step(); }
+    void back() { bindings_.back(); }
+    void clear() { bindings_.clear(); }
+    // by_address: an array or struct, loading it hands out the alloca instead of its value
+    void add_variant(Symbol name, llvm::AllocaInst* inst, bool by_address = false);
+    void add_constant(Symbol name, llvm::Value* constant);
 
-    llvm::Value* load(llvm::IRBuilder<>* builder, const std::string& name);
-    bool store(llvm::IRBuilder<>* builder, const std::string& name, llvm::Value* target);
-    bool store(llvm::IRBuilder<>* builder, const std::string& name, llvm::Value* target, std::vector<llvm::Value*> offsets);
+    llvm::Value* load(llvm::IRBuilder<>* builder, Symbol name);
+    bool store(llvm::IRBuilder<>* builder, Symbol name, llvm::Value* target);
+    bool store(llvm::IRBuilder<>* builder, Symbol name, llvm::Value* target, std::vector<llvm::Value*> offsets);
 
-    using ElementOrOffset = std::variant<std::string, llvm::Value*>;
+    // a struct member position or an array offset
+    using ElementOrOffset = std::variant<unsigned int, llvm::Value*>;
     bool store(
         llvm::IRBuilder<>* builder, 
-        const std::string& name, 
+        Symbol name, 
         llvm::Value* target, 
-        std::vector<ElementOrOffset> addrs, 
-        TypeManager& type_manager);
-    std::string& find_symbol_type_str(std::string& symbol_name);
+        std::vector<ElementOrOffset> addrs);
 private:
-    std::vector<std::unordered_map<std::string, std::pair<llvm::AllocaInst*, std::string>>> variant_scoped_blocks_;
-    std::vector<std::unordered_map<std::string, std::pair<llvm::Value*, std::string>>> constant_scoped_blocks_;
+    struct Binding {
+        llvm::Value* value;           // the alloca of a variant, the value of a constant
+        bool is_variant;
+        bool by_address;
+    };
+
+    ScopedTable<Binding> bindings_;
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "target.hpp"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Target/TargetOptions.h>
+
+TargetSelection resolve_target(const TargetSelection& target) {
+    if (target.cpu != "native") {
+        return target;
+    }
+
+    llvm::SubtargetFeatures features;
+    llvm::StringMap<bool> host_features;
+    if (llvm::sys::getHostCPUFeatures(host_features)) {
+        for (auto& feature: host_features) {
+            features.AddFeature(feature.first(), feature.second);
+        }
+    }
+    llvm::SubtargetFeatures requested(target.features);
+    for (auto& feature: requested.getFeatures()) {
+        features.AddFeature(feature);
+    }
+    return {llvm::sys::getHostCPUName().str(), features.getString()};
+}
+
+std::unique_ptr<llvm::TargetMachine> create_target_machine(
+    const std::string& triple, const TargetSelection& target, llvm::CodeGenOpt::Level level, std::string& err) {
+    auto llvm_target = llvm::TargetRegistry::lookupTarget(triple, err);
+    if (!llvm_target) {
+        return nullptr;
+    }
+
+    auto resolved = resolve_target(target);
+    llvm::TargetOptions options;
+    auto machine = llvm_target->createTargetMachine(
+        triple, resolved.cpu, resolved.features, options, llvm::Optional<llvm::Reloc::Model>(), llvm::None, level);
+    return std::unique_ptr<llvm::TargetMachine>(machine);
+}
+
+void select_target(llvm::orc::JITTargetMachineBuilder& builder, const TargetSelection& target,
+                   llvm::CodeGenOpt::Level level) {
+    auto resolved = resolve_target(target);
+    builder.setCPU(resolved.cpu);
+    builder.addFeatures(llvm::SubtargetFeatures(resolved.features).getFeatures());
+    builder.setCodeGenOptLevel(level);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Target/TargetMachine.h>
+#include <memory>
+#include <string>
+
+/// TargetSelection names the cpu and the extra features machine code is generated for.
+struct TargetSelection {
+    std::string cpu = "native"; // "native" asks the host, anything else is an llvm cpu name like "skylake"
+    std::string features;       // "+avx2,-fma" style, applied on top of what the cpu has
+};
+
+// turns "native" into the host cpu name and its full feature string, explicit features come last so they win
+TargetSelection resolve_target(const TargetSelection& target);
+
+// the target machine for ahead of time object files, nullptr with err set when the triple is unknown
+std::unique_ptr<llvm::TargetMachine> create_target_machine(
+    const std::string& triple, const TargetSelection& target, llvm::CodeGenOpt::Level level, std::string& err);
+
+// the same selection for a JIT, which builds its own target machines from it
+void select_target(llvm::orc::JITTargetMachineBuilder& builder, const TargetSelection& target,
+                   llvm::CodeGenOpt::Level level);
@@ -0,0 +1,210 @@
+#include "tiered_compiler.hpp"
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+
+#include <atomic>
+
+namespace {
+
+const char* const tier_up_symbol = "__kalei_tier_up";
+// the compiler itself, by name, so baselines hold no addresses of this run and fit the object cache
+const char* const tiers_symbol = "__kalei_tiers";
+
+}  // namespace
+
+TieredCompiler::TieredCompiler(OrcJitEngine& jit, unsigned hot_call_threshold)
+    : jit_(jit), hot_call_threshold_(hot_call_threshold) {
+    llvm::cantFail(jit_.define_absolute(tier_up_symbol, llvm::pointerToJITTargetAddress(&TieredCompiler::on_hot)));
+    llvm::cantFail(jit_.define_absolute(tiers_symbol, llvm::pointerToJITTargetAddress(this)));
+    worker_ = std::thread([this] { work(); });
+}
+
+TieredCompiler::~TieredCompiler() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+        queue_.clear();
+    }
+    wake_.notify_all();
+    worker_.join();
+}
+
+llvm::Error TieredCompiler::add(llvm::Function& function, std::unique_ptr<llvm::Module> module,
+                                llvm::orc::ThreadSafeContext context) {
+    std::string name = function.getName().str();
+    // the body moves aside for a declaration of the stub, so recursive calls go through the stub too
+    function.setName(name + ".tier0");
+    auto stub = llvm::Function::Create(function.getFunctionType(), llvm::Function::ExternalLinkage, name, *module);
+    function.replaceAllUsesWith(stub);
+
+    std::string bitcode;
+    llvm::raw_string_ostream bitcode_stream(bitcode);
+    llvm::WriteBitcodeToFile(*module, bitcode_stream);
+    bitcode_stream.flush();
+
+    int32_t index;
+    {
+        std::lock_guard lock(mutex_);
+        index = static_cast<int32_t>(entries_.size());
+        entries_.push_back(Entry {.name = name, .bitcode = std::move(bitcode)});
+    }
+    instrument(function, index);
+
+    // the baseline links against the stub, so the stub exists before the baseline is compiled
+    if (auto err = jit_.define_stub(name, 0)) {
+        return err;
+    }
+    if (auto err = jit_.add_baseline_module(llvm::orc::ThreadSafeModule(std::move(module), std::move(context)))) {
+        return err;
+    }
+    pending_.push_back(index);
+    return llvm::Error::success();
+}
+
+llvm::Error TieredCompiler::compile_pending() {
+    if (pending_.empty()) {
+        return llvm::Error::success();
+    }
+
+    std::vector<std::string> names;
+    for (auto index: pending_) {
+        names.push_back(entries_[index].name + ".tier0");
+        names.push_back(entries_[index].name + ".calls");
+    }
+    auto pending = std::move(pending_);
+    pending_.clear();
+    auto symbols = jit_.lookup_all(names);
+    if (!symbols) {
+        return symbols.takeError();
+    }
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        auto& entry = entries_[pending[i]];
+        {
+            std::lock_guard lock(mutex_);
+            entry.calls = llvm::jitTargetAddressToPointer<int32_t*>((*symbols)[2 * i + 1].getAddress());
+        }
+        if (auto err = jit_.redirect_stub(entry.name, (*symbols)[2 * i].getAddress())) {
+            return err;
+        }
+    }
+    return llvm::Error::success();
+}
+
+void TieredCompiler::instrument(llvm::Function& function, int32_t index) {
+    auto& module = *function.getParent();
+    auto& context = module.getContext();
+    auto i32 = llvm::Type::getInt32Ty(context);
+    auto calls = new llvm::GlobalVariable(module, i32, false, llvm::GlobalValue::ExternalLinkage,
+                                          llvm::ConstantInt::get(i32, 0), entries_[index].name + ".calls");
+
+    // counted after the allocas, so they stay in the entry block
+    auto& entry = function.getEntryBlock();
+    auto position = entry.getFirstInsertionPt();
+    while (llvm::isa<llvm::AllocaInst>(*position)) {
+        ++position;
+    }
+    llvm::IRBuilder<> builder(&entry, position);
+    // atomic, calls from several threads must not lose counts or pass the threshold without hitting it
+    auto previous = builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, calls, builder.getInt32(1), llvm::Align(4),
+                                            llvm::AtomicOrdering::Monotonic);
+    auto count = builder.CreateAdd(previous, builder.getInt32(1), "calls");
+    auto is_hot = builder.CreateICmpEQ(count, builder.getInt32(hot_call_threshold_), "hot");
+
+    builder.SetInsertPoint(llvm::SplitBlockAndInsertIfThen(is_hot, &*builder.GetInsertPoint(), false));
+    auto pointer = builder.getInt8PtrTy();
+    auto hook = module.getOrInsertFunction(
+        tier_up_symbol, llvm::FunctionType::get(builder.getVoidTy(), {pointer, i32}, false));
+    auto self = module.getOrInsertGlobal(tiers_symbol, builder.getInt8Ty());
+    builder.CreateCall(hook, {self, builder.getInt32(index)});
+}
+
+void TieredCompiler::on_hot(TieredCompiler* self, int32_t index) {
+    {
+        std::lock_guard lock(self->mutex_);
+        auto& entry = self->entries_[index];
+        if (entry.tier != Tier::Baseline) {
+            return;
+        }
+        entry.tier = Tier::Recompiling;
+        self->queue_.push_back(index);
+    }
+    self->wake_.notify_all();
+}
+
+void TieredCompiler::work() {
+    for (;;) {
+        Entry* entry = nullptr;
+        {
+            std::unique_lock lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            entry = &entries_[queue_.front()];
+            queue_.pop_front();
+            busy_ = true;
+        }
+
+        // name and bitcode never change once added, only the tier is shared with the jitted code
+        bool optimized = recompile(*entry);
+        {
+            std::lock_guard lock(mutex_);
+            entry->tier = optimized ? Tier::Optimized : Tier::Baseline;
+            busy_ = false;
+        }
+        wake_.notify_all();
+    }
+}
+
+bool TieredCompiler::recompile(const Entry& entry) {
+    // a context of its own, nothing here is shared with the thread lowering new functions
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto buffer = llvm::MemoryBuffer::getMemBuffer(entry.bitcode, entry.name, false);
+    auto module = llvm::parseBitcodeFile(buffer->getMemBufferRef(), *context);
+    if (!module) {
+        llvm::logAllUnhandledErrors(module.takeError(), llvm::errs(), "tier up of " + entry.name + ": ");
+        return false;
+    }
+    (*module)->getFunction(entry.name + ".tier0")->setName(entry.name + ".tier1");
+
+    if (auto err = jit_.add_module(llvm::orc::ThreadSafeModule(std::move(*module), std::move(context)))) {
+        llvm::logAllUnhandledErrors(std::move(err), llvm::errs(), "tier up of " + entry.name + ": ");
+        return false;
+    }
+    auto body = jit_.lookup(entry.name + ".tier1");
+    if (!body) {
+        llvm::logAllUnhandledErrors(body.takeError(), llvm::errs(), "tier up of " + entry.name + ": ");
+        return false;
+    }
+    if (auto err = jit_.redirect_stub(entry.name, body->getAddress())) {
+        llvm::logAllUnhandledErrors(std::move(err), llvm::errs(), "tier up of " + entry.name + ": ");
+        return false;
+    }
+    return true;
+}
+
+void TieredCompiler::wait_idle() {
+    std::unique_lock lock(mutex_);
+    wake_.wait(lock, [this] { return queue_.empty() && !busy_; });
+}
+
+void TieredCompiler::print_stats(llvm::raw_ostream& os) {
+    std::lock_guard lock(mutex_);
+    os << entries_.size() << " tiered functions, threshold " << hot_call_threshold_ << " calls\n";
+    for (auto& entry: entries_) {
+        os << "  " << entry.name << ": ";
+        switch (entry.tier) {
+        case Tier::Baseline: os << "tier 0, " << (entry.calls ? std::atomic_ref<int32_t>(*entry.calls).load(std::memory_order_relaxed) : 0) << " calls\n"; break;
+        case Tier::Recompiling: os << "tier 0, recompiling\n"; break;
+        case Tier::Optimized: os << "tier 1\n"; break;
+        }
+    }
+}
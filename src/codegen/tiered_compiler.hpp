@@ -0,0 +1,63 @@
+#pragma once
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "jit_engine.hpp"
+
+/// TieredCompiler puts every function it is given behind a stub, first on a quickly compiled
+/// baseline which counts its calls. When the count reaches the threshold the function is compiled
+/// again by the optimizing engine on a background thread, and the stub is pointed at the new code.
+class TieredCompiler {
+public:
+    TieredCompiler(OrcJitEngine& jit, unsigned hot_call_threshold);
+    ~TieredCompiler();
+
+    // takes over the module and context of a function just lowered, its stub is callable after compile_pending
+    llvm::Error add(llvm::Function& function, std::unique_ptr<llvm::Module> module,
+                    llvm::orc::ThreadSafeContext context);
+    // compiles the baselines added since the last call all at once and points their stubs at them
+    llvm::Error compile_pending();
+
+    // blocks until no recompilation is queued or running
+    void wait_idle();
+    void print_stats(llvm::raw_ostream& os);
+private:
+    enum class Tier {Baseline, Recompiling, Optimized};
+    struct Entry {
+        std::string name;
+        std::string bitcode;     // the function before instrumentation, in its own module
+        int32_t* calls = nullptr; // the baseline counter, inside jitted data
+        Tier tier = Tier::Baseline;
+    };
+
+    // called from baseline code when a counter reaches the threshold
+    static void on_hot(TieredCompiler* self, int32_t index);
+    void instrument(llvm::Function& function, int32_t index);
+    bool recompile(const Entry& entry);
+    void work();
+
+    OrcJitEngine& jit_;
+    unsigned hot_call_threshold_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Entry> entries_; // a deque keeps entries in place while more are added
+    std::vector<int32_t> pending_; // added but not compiled yet, only the lowering thread touches it
+    std::deque<int32_t> queue_;
+    bool busy_ = false;
+    bool stopping_ = false;
+    std::thread worker_;
+};
@@ -1,16 +1,21 @@
 #include "ast/lexer.hpp"
+#include "ast/parallel_parser.hpp"
 #include "ast/parser.hpp"
 #include "ast/semantic.hpp"
+#include "ast/source.hpp"
 #include "ast/token.hpp"
 #include "codegen/codegen.hpp"
 #include "codegen/jit_codegen.hpp"
 #include <cassert>
+#include <charconv>
 #include <cstdlib>
-#include <fstream>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm-c/Target.h>
 #include <llvm/Support/raw_ostream.h>
 #include <string>
+#include <string_view>
+#include <thread>
 
 namespace {
     using namespace std;
@@ -18,7 +23,7 @@ namespace {
 
 enum class Stage {Tokens, Parser, Codegen, Target, FileIO};
 
-void file_driver(std::string&& file_input, std::string&& file_output) {
+void file_driver(std::string&& file_input, std::string&& file_output, unsigned jobs) {
     std::error_code ec;
     llvm::raw_fd_ostream output(file_output, ec, llvm::sys::fs::OF_None);
     if (ec) {
@@ -30,18 +35,51 @@ void file_driver(std::string&& file_input, std::string&& file_output) {
         .function_pass_optimize = true,
     };
 
-    auto generator = CodeGenerator(output, setting);
+    std::string err;
+    auto source = SourceBuffer::open(file_input, err);
+    if (!source) {
+        cout << "Could not open file: " << err << '\n';
+        exit(1);
+    }
 
-    std::ifstream ifs(file_input);
-    std::string line;
+    auto generator = CodeGenerator(output, setting);
+    TypeChecker checker(generator.type_manager_);
 
-    while (std::getline(ifs, line, ';')) { // use ';' as delimeter
-        auto tokens = Lexer::tokenize(line);
-        tokens.emplace_back(TokenType::Eof);
+    auto compile = [&](ASTNodePtr ast) {
+        if (!checker.check(*ast)) {
+            cout << "TypeChecker failed at: \n" << *ast << endl;
+            cout << checker.err_ << endl;
+            return;
+        }
+        std::vector<ASTNodePtr> asts;
+        asts.push_back(std::move(ast));
+        generator.codegen(std::move(asts));
+    };
 
-        auto parser = Parser(std::move(tokens), generator.binary_oper_precedence_);
+    if (jobs > 1) {
+        // the front end runs on all jobs before anything is checked or generated
+        auto parser = ParallelParser(source->view(), generator.binary_oper_precedence_, jobs);
         auto asts = parser.parse();
-        generator.codegen(std::move(asts));
+        if (parser.failed()) {
+            // nothing is kept of a failed parse, not even the items before the error
+            cout << "Parser failed, " << file_input << " was not compiled" << endl;
+            exit(1);
+        }
+        for (auto& ast: asts) {
+            compile(std::move(ast));
+        }
+        return;
+    }
+
+    // one parser walks the whole mapped file, top level items are split by the grammar
+    auto parser = Parser(Lexer(source->view()), generator.binary_oper_precedence_);
+    while (auto ast = parser.parse_top_level()) {
+        compile(std::move(ast));
+    }
+    if (parser.failed()) {
+        // the items after the error are not compiled, the output is incomplete
+        cout << "Parser failed, " << file_input << " was not compiled to the end" << endl;
+        exit(1);
     }
 }
 
@@ -51,9 +89,18 @@ void driver(Stage stage) {
     CodeGeneratorSetting setting = {
         .print_ir = true,
         .function_pass_optimize = true,
+        .tiered_compile = true,
+        .compile_threads = std::thread::hardware_concurrency(),
     };
+    llvm::SmallString<128> cache_directory;
+    if (llvm::sys::path::cache_directory(cache_directory)) {
+        llvm::sys::path::append(cache_directory, "kalei");
+        setting.object_cache.directory = std::string(cache_directory);
+    }
 
     if (stage == Stage::Target) {
+        // print() runs the module pipeline over everything, simplifying at lowering too would do it twice
+        setting.function_pass_optimize = false;
         generator = new CodeGenerator(llvm::errs(), setting);
     } else {
         generator = new JitCodeGenerator(llvm::errs(), setting);
@@ -68,19 +115,26 @@ void driver(Stage stage) {
         if (input == ".quit") {
             break;
         }
+        if (input == ".stats") {
+            if (auto jit = dynamic_cast<JitCodeGenerator*>(generator)) {
+                jit->print_tier_stats(llvm::outs());
+                jit->print_cache_stats(llvm::outs());
+                jit->print_exec_stats(llvm::outs());
+                llvm::outs().flush();
+            }
+            continue;
+        }
 
         for (;;) {
-            auto tokens = Lexer::tokenize(input);
             if (stage == Stage::Tokens) {
-                for (const auto& token: tokens) {
+                for (const auto& token: Lexer::tokenize(input)) {
                     cout << token << ' ';
                 }
                 cout << endl;
                 break;
             } 
-            tokens.emplace_back(TokenType::Eof);
 
-            auto parser = Parser(std::move(tokens), generator->binary_oper_precedence_);
+            auto parser = Parser(Lexer(input), generator->binary_oper_precedence_);
             auto asts = parser.parse();
             if (stage == Stage::Parser) {
                 for (auto& ast: asts) {
@@ -111,9 +165,19 @@ void driver(Stage stage) {
 int main(int argv, char** args) {
     auto state = Stage::Codegen;
 
-    if (state == Stage::Target) {
-        assert(argv == 3);
-        file_driver(args[1], args[2]);
+    // kalei <input> <output> [jobs]
+    if (argv == 3 || argv == 4) {
+        unsigned jobs = 1;
+        if (argv == 4) {
+            std::string_view text = args[3];
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), jobs);
+            if (ec != std::errc() || end != text.data() + text.size() || jobs == 0) {
+                cout << "usage: " << args[0] << " <input> <output> [jobs]\n"
+                     << "jobs is the number of parsing threads, a positive integer" << endl;
+                return 1;
+            }
+        }
+        file_driver(args[1], args[2], jobs);
         return 0;
     }
 
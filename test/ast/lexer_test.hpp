@@ -50,4 +50,41 @@ TEST(AST, tokenize) {
 
         ASSERT_EQ(serialize_tokens(ans), answer[i]);
     }
-}
\ No newline at end of file
+}
+
+TEST(AST, tokenizeMatchesRegex) {
+    std::vector<std::string> target = {
+        "def f(x: double) -> double { return x + x; }",
+        "exec: double 2 + 3",
+        "a->b - >c --> -= x+-y +,1 *.5 1.2.3 4. :=",
+        "x#comment\ny +#comment\n= z ###",
+        "var a: array%array%double%2%2 = [[2, 2]:double, [3, 3]:double]:double;",
+        "def binary | 5 (LHS: double, RHS: double) -> double {if (!LHS) {return 0;} else {return !(!RHS);}};",
+        "struct Foo {a: i32, b: array%Foo%2,}\n\tval c: Foo; c.b[1].a = 1 == 2 <= 3 @ ^ ` ~ ? $ & '",
+        "def g(x: double)  -> double {return (1 + 2 + x)*(x + (1 + 2));};",
+    };
+
+    for (auto& source: target) {
+        auto dfa_tokens = Lexer::tokenize(source);
+        auto re2_tokens = Lexer::tokenize_re2(source);
+        ASSERT_EQ(serialize_tokens(dfa_tokens), serialize_tokens(re2_tokens)) << source;
+    }
+
+    ASSERT_TRUE(Lexer::tokenize("a _b").empty());
+    ASSERT_TRUE(Lexer::tokenize_re2("a _b").empty());
+}
+
+TEST(AST, internedTokens) {
+    std::string source = "def foo(x: double) foo(x) # foo";
+    auto tokens = Lexer::tokenize(source);
+
+    ASSERT_EQ(tokens[1].get_symbol(), tokens[7].get_symbol());
+    ASSERT_EQ(tokens[3].get_symbol(), tokens[9].get_symbol());
+    ASSERT_NE(tokens[1].get_symbol(), tokens[3].get_symbol());
+    ASSERT_EQ(tokens[1].get_symbol(), Symbol("foo"));
+    ASSERT_EQ(tokens[1].get_string(), "foo");
+
+    ASSERT_EQ(tokens[7].offset_, 19);
+    ASSERT_EQ(tokens[7].length_, 3);
+    ASSERT_EQ(source.substr(tokens[4].offset_, tokens[4].length_), ":");
+}
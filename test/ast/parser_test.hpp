@@ -3,9 +3,15 @@
 #include <gtest/gtest.h>
 #include "ast/ast.hpp"
 #include "ast/lexer.hpp"
+#include "ast/parallel_parser.hpp"
 #include "ast/parser.hpp"
+#include "ast/source.hpp"
+#include "ast/type.hpp"
 
-std::map<std::string, int> parser_prec = {{"<", 10}, {"+", 20}, {"-", 20}, {"*", 40}};
+#include <cstdio>
+#include <fstream>
+
+std::unordered_map<Symbol, int> parser_prec = {{Symbol("<"), 10}, {Symbol("+"), 20}, {Symbol("-"), 20}, {Symbol("*"), 40}};
 
 std::string serialize_asts(std::vector<ASTNodePtr>& asts) {
     std::stringstream ss;
@@ -44,9 +50,137 @@ TEST(AST, parse) {
 
     assert(target.size() == answer.size());
     for (int i = 0; i < target.size(); i++) {
-        auto parser = Parser(Lexer::tokenize(target[i]), parser_prec);
+        auto parser = Parser(Lexer(target[i]), parser_prec);
         auto ans = parser.parse();
 
         ASSERT_EQ(serialize_asts(ans), answer[i]);
     }
-}
\ No newline at end of file
+}
+
+TEST(AST, tokenStream) {
+    std::string source = "exec f(1, 2)";
+    TokenStream stream{Lexer(source)};
+
+    ASSERT_EQ(stream.current().type_, TokenType::Exec);
+    ASSERT_EQ(stream.peek(2).type_, TokenType::LeftParenthesis);
+    ASSERT_EQ(stream.peek(5).type_, TokenType::Literal);
+    stream.advance();
+    stream.advance();
+    ASSERT_EQ(stream.previous().type_, TokenType::Identifier);
+    ASSERT_EQ(stream.current().type_, TokenType::LeftParenthesis);
+    for (int i = 0; i < 10; i++) {
+        stream.advance();
+    }
+    ASSERT_EQ(stream.current().type_, TokenType::Eof);
+}
+
+TEST(AST, parseStream) {
+    std::string source;
+    for (int i = 0; i < 1000; i++) {
+        source += "def f" + std::to_string(i) + "(x: double) -> double { return x + " + std::to_string(i) + "; }\n";
+    }
+    auto parser = Parser(Lexer(source), parser_prec);
+    ASSERT_EQ(parser.parse().size(), 1000);
+
+    source += "exec _bad";
+    auto failed_parser = Parser(Lexer(source), parser_prec);
+    ASSERT_TRUE(failed_parser.parse().empty());
+}
+
+TEST(AST, parseMappedSource) {
+    std::string path = ::testing::TempDir() + "kalei_mapped_source.k";
+    {
+        std::ofstream ofs(path);
+        ofs << "def f(x: double) -> double { var y: double = x * 2; return y + 1; }\n"
+            << "extern sin(x: double) -> double;\n"
+            << "exec f(1);";
+    }
+
+    std::string err;
+    auto source = SourceBuffer::open(path, err);
+    ASSERT_NE(source, nullptr) << err;
+
+    auto parser = Parser(Lexer(source->view()), parser_prec);
+    auto first = parser.parse_top_level();
+    ASSERT_NE(first, nullptr);
+    ASSERT_TRUE(std::holds_alternative<FunctionNode>(first->data));
+    ASSERT_NE(parser.parse_top_level(), nullptr);
+    ASSERT_NE(parser.parse_top_level(), nullptr);
+    ASSERT_EQ(parser.parse_top_level(), nullptr);
+    ASSERT_FALSE(parser.failed());
+
+    auto token = Lexer(source->view()).next();
+    ASSERT_EQ(token.text(source->view()), "def");
+
+    ASSERT_EQ(SourceBuffer::open(path + ".missing", err), nullptr);
+    std::remove(path.c_str());
+}
+
+TEST(AST, parseParallel) {
+    std::string source = "extern sin(x: double) -> double;\n";
+    for (int i = 0; i < 2000; i++) {
+        source += "def f" + std::to_string(i) + "(x: double) -> double { # def in a comment\n"
+            "    for (i = 0: double, i < x) { x + 1; } return x + " + std::to_string(i) + "; }\n";
+        if (i == 1000) {
+            source += "def binary| 5 (x: double, y: double) -> double { return x; }\n"
+                "exec 1 | 2 + 3;\n";
+        }
+    }
+
+    auto items = ParallelParser::split_top_level(source);
+    ASSERT_EQ(items.size(), 2003);
+    ASSERT_TRUE(items[1002].defines_operator);
+
+    auto prec = parser_prec;
+    auto sequential = Parser(Lexer(source), prec).parse();
+    auto parallel_prec = parser_prec;
+    auto parallel = ParallelParser(source, parallel_prec, 4).parse();
+    ASSERT_EQ(parallel.size(), sequential.size());
+    ASSERT_EQ(serialize_asts(parallel), serialize_asts(sequential));
+
+    source += "exec _bad";
+    auto failed_prec = parser_prec;
+    auto failed_parser = ParallelParser(source, failed_prec, 4);
+    ASSERT_TRUE(failed_parser.parse().empty());
+    ASSERT_TRUE(failed_parser.failed());
+}
+
+TEST(AST, arenaOwnsTree) {
+    std::vector<ASTNodePtr> asts;
+    {
+        auto parser = Parser(Lexer("def f(x: double) -> double { return g(x, [1, 2]: double); } exec f(1);"), parser_prec);
+        asts = parser.parse();
+    }
+    ASSERT_EQ(asts.size(), 2);
+    ASSERT_EQ(asts[0]->arena, asts[1]->arena);
+    ASSERT_GT(asts[0]->arena->bytes_allocated(), 0);
+
+    // the nodes stay reachable through the arena the items share, after the parser is gone
+    auto& f = std::get<FunctionNode>(asts[0]->data);
+    ASSERT_EQ(f.prototype->args.size(), 1);
+    ASSERT_EQ(f.prototype->answer.str(), "double");
+    auto ret = expr_cast<ReturnExpr>(f.body.data.front());
+    ASSERT_NE(ret, nullptr);
+    auto call = expr_cast<CallExpr>(ret->ret);
+    ASSERT_NE(call, nullptr);
+    ASSERT_EQ(call->args.size(), 2);
+    ASSERT_EQ(expr_cast<ArrayExpr>(call->args[1])->type.str(), "array%double%2");
+}
+
+TEST(AST, typeInterning) {
+    TypeManager manager;
+    auto nested = manager.find_type_by_name(std::string("array%array%double%2%3"));
+    auto again = manager.find_type_by_name(Symbol("array%array%double%2%3"));
+    ASSERT_EQ(nested, again);
+    ASSERT_EQ(nested->name(), "array%array%double%2%3");
+
+    auto inner = static_cast<TypeSystem::ArrayType*>(nested)->element_type;
+    ASSERT_EQ(inner->id, manager.array_of(TypeSystem::BuiltinTypes::f64, 2));
+    ASSERT_NE(inner->id, manager.array_of(TypeSystem::BuiltinTypes::i32, 2));
+    ASSERT_TRUE(TypeSystem::is_same_type(inner->id, TypeSystem::BuiltinTypes::any));
+
+    llvm::LLVMContext context;
+    auto llvm_type = nested->llvm_type(context);
+    ASSERT_EQ(llvm_type, nested->llvm_type(context));
+    ASSERT_EQ(llvm_type, llvm::ArrayType::get(llvm::ArrayType::get(llvm::Type::getDoubleTy(context), 2), 3));
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cassert>
+#include <functional>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/raw_ostream.h>
 #include <string>
 #include <vector>
@@ -13,18 +15,18 @@
 #include "ast/semantic.hpp"
 #include "codegen/jit_codegen.hpp"
 
-void codegen_helper(std::vector<std::string>& target, std::vector<std::string>& answer) {
+// one generator runs every target in turn and prints its answer, after(generator, i) may look at the
+// generator once target[i] is done
+void codegen_helper(const std::vector<std::string>& target, const std::vector<std::string>& answer,
+                    CodeGeneratorSetting setting = {.print_ir = false, .function_pass_optimize = true},
+                    const std::function<void(JitCodeGenerator&, size_t)>& after = nullptr) {
     std::string ans = "";
     llvm::raw_string_ostream output(ans); 
-    CodeGeneratorSetting setting = {
-        .print_ir = false,
-        .function_pass_optimize = true,
-    };
     auto generator = JitCodeGenerator(output, setting);
     TypeChecker checker(generator.type_manager_);
 
     for (int i = 0; i < target.size(); i++) {
-        auto parser = Parser(Lexer::tokenize(target[i]), generator.binary_oper_precedence_);
+        auto parser = Parser(Lexer(target[i]), generator.binary_oper_precedence_);
         auto asts = parser.parse();
 
         for (auto& ast: asts) {
@@ -37,6 +39,9 @@ void codegen_helper(std::vector<std::string>& target, std::vector<std::string>&
         generator.codegen(std::move(asts));
         ASSERT_EQ(ans, answer[i]);
         ans.clear();
+        if (after) {
+            after(generator, i);
+        }
     }
 }
 
@@ -176,19 +181,19 @@ TEST(CODEGEN, oper) {
     std::vector<std::string> target = {
 /*         "def unary - (v) 0 - v;",
         "-(2+3)", */
-        "def unary ! (v: double) -> double {if (v) {return 0;} else {return 1;}};",
+        "def unary ! (v: double) -> double {if (bool(v)) {return 0;} else {return 1;}};",
         "exec: double !1",
         "exec: double !0",
-        "def binary | 5 (LHS: double, RHS: double) -> double {if (LHS) {return 1;} else {if (RHS) {return 1;} else {return 0;}}};",
+        "def binary | 5 (LHS: double, RHS: double) -> double {if (bool(LHS)) {return 1;} else {if (bool(RHS)) {return 1;} else {return 0;}}};",
         "exec: double 0|0",
         "exec: double 1|0",
-        "def binary & 6 (LHS: double, RHS: double) -> double {if (!LHS) {return 0;} else {return !(!RHS);}};",
+        "def binary & 6 (LHS: double, RHS: double) -> double {if (bool(!LHS)) {return 0;} else {return !(!RHS);}};",
         "exec: double 1&0",
         "exec: double 1&1",
-        "def binary > 10 (LHS: double, RHS: double) -> double {return RHS < LHS;};",
+        "def binary > 10 (LHS: double, RHS: double) -> double {return double(RHS < LHS);};",
         "exec: double 1 > 2",
         "exec: double 2 > 1",
-        "def binary == 9 (LHS: double, RHS: double) -> double {return !(RHS < LHS | RHS > LHS);};",
+        "def binary == 9 (LHS: double, RHS: double) -> double {return !(double(RHS < LHS) | RHS > LHS);};",
         "exec: double 1 == 0",
         "exec: double 1 == 1",
     };
@@ -217,6 +222,35 @@ TEST(CODEGEN, oper) {
     codegen_helper(target, answer);
 }
 
+TEST(CODEGEN, boolean) {
+    std::vector<std::string> target = {
+        "def positive(x: i32) -> bool {return 0 < x;}",
+        "def pick(x: double, y: double) -> double {var b: bool = false; b = x < y; if (b) {return x;} else {return y;}}",
+        "exec positive(3)",
+        "exec positive(0 - 3)",
+        "exec: bool 1 < 2",
+        "exec: bool false",
+        "exec pick(2, 1)",
+        "exec: i32 i32(true) + i32(2.5)",
+        "exec: double double(bool(0.5))",
+    };
+
+    std::vector<std::string> answer = {
+        "parsed function definition.\n",
+        "parsed function definition.\n",
+        "true\n",
+        "false\n",
+        "true\n",
+        "false\n",
+        "1.000000\n",
+        "3\n",
+        "1.000000\n",
+    };
+
+    assert(target.size() == answer.size());
+    codegen_helper(target, answer);
+}
+
 TEST(CODEGEN, variant) {
     std::vector<std::string> target = {
         "def fibi(x: double) -> double {var a: double = 1; var b: double = 1; var c: double; for (i = 3: double, i < x) {c = a + b; a = b; b = c;} return b;};",
@@ -247,6 +281,21 @@ TEST(CODEGEN, invariant) {
     codegen_helper(target, answer);
 }
 
+TEST(CODEGEN, shadow) {
+    std::vector<std::string> target = {
+        "def f(n: double) -> double {var y: double = 1; for (i = 0: double, i < n) {var y: double = 2; y = y + i;} var z: double = y; return z + y;}",
+        "exec f(3)",
+    };
+
+    std::vector<std::string> answer = {
+        "parsed function definition.\n",
+        "2.000000\n",
+    };
+
+    assert(target.size() == answer.size());
+    codegen_helper(target, answer);
+}
+
 TEST(CODEGEN, loopInt) {
     std::vector<std::string> target = {
         "def sum(n: double) -> i32 {var a: i32 = 0; var b: i32 = 0; for (i = 0: double, i < n) {b = a + b; a = a + 1;} return b; }",
@@ -262,6 +311,238 @@ TEST(CODEGEN, loopInt) {
     codegen_helper(target, answer);
 }
 
+TEST(CODEGEN, loopInduction) {
+    std::vector<std::string> target = {
+        "def count(n: i32) -> i32 {var b: i32 = 0; for (i = 0: i32, i < n) {b = b + i;} return b; }",
+        "def evens(n: i32) -> i32 {var b: i32 = 0; for (i = 0: i32, i < n, 2) {b = b + i;} return b; }",
+        "def halves(n: double) -> double {var b: double = 0; for (i = 0, i < n, 0.5) {b = b + i;} return b; }",
+        "exec count(100)",
+        "exec evens(10)",
+        "exec halves(2)",
+    };
+
+    std::vector<std::string> answer = {
+        "parsed function definition.\n",
+        "parsed function definition.\n",
+        "parsed function definition.\n",
+        "5050\n",
+        "30\n",
+        "5.000000\n",
+    };
+
+    assert(target.size() == answer.size());
+    codegen_helper(target, answer);
+}
+
+TEST(CODEGEN, lazyCompile) {
+    std::vector<std::string> target = {
+        "extern sin(x: double) -> double",
+        "def never(x: double) -> double {return sin(x) * 2;}",
+        "def fibo(n: i32) -> i32 {if (n < 2) {return n;} else {return fibo(n - 1) + fibo(n - 2);}}",
+        "def twice(n: i32) -> i32 {return fibo(n) + fibo(n);}",
+        "exec twice(10)",
+        "exec fibo(12)",
+    };
+
+    std::vector<std::string> answer = {
+        "declare double @sin(double)\n",
+        "parsed function definition.\n",
+        "parsed function definition.\n",
+        "parsed function definition.\n",
+        "110\n",
+        "144\n",
+    };
+
+    assert(target.size() == answer.size());
+    codegen_helper(target, answer, CodeGeneratorSetting {.print_ir = false, .lazy_compile = true});
+}
+
+TEST(CODEGEN, parallelCompile) {
+    // one batch of definitions, compiled side by side before the first exec needs them
+    std::vector<std::string> target = {
+        "def a(x: double) -> double {return x + 1;}"
+        "def b(x: double) -> double {return a(x) * 2;}"
+        "def c(x: double) -> double {return b(x) + a(x);}"
+        "def d(x: i32) -> i32 {var s: i32 = 0; for (i = 0: i32, i < x) {s = s + i;} return s;}"
+        "exec c(1)",
+        "exec d(10)",
+    };
+
+    std::vector<std::string> answer = {
+        "parsed function definition.\n"
+        "parsed function definition.\n"
+        "parsed function definition.\n"
+        "parsed function definition.\n"
+        "6.000000\n",
+        "55\n",
+    };
+
+    assert(target.size() == answer.size());
+    codegen_helper(target, answer, CodeGeneratorSetting {.print_ir = false, .compile_threads = 4});
+}
+
+TEST(CODEGEN, objectCache) {
+    llvm::SmallString<128> directory;
+    ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("kalei-object-cache", directory));
+    auto setting = CodeGeneratorSetting {.print_ir = false};
+    setting.object_cache.directory = std::string(directory);
+
+    // the second run loads sq and the bridge the interpreter calls it through back from disk
+    auto run = [&]() {
+        std::string stats = "";
+        llvm::raw_string_ostream stats_output(stats);
+        codegen_helper({"def sq(x: i32) -> i32 {return x * x;} exec sq(7)"}, {"parsed function definition.\n49\n"},
+                       setting, [&](JitCodeGenerator& generator, size_t) { generator.print_cache_stats(stats_output); });
+        return stats;
+    };
+
+    ASSERT_NE(run().find("0 hits, 2 misses, 2 stored"), std::string::npos);
+    ASSERT_NE(run().find("2 hits, 0 misses, 0 stored"), std::string::npos);
+    llvm::sys::fs::remove_directories(directory);
+}
+
+TEST(CODEGEN, execBatch) {
+    // more execs in one batch than are kept before a release, with definitions in between
+    std::string source = "def sq(x: i32) -> i32 {return x * x;}";
+    std::string expected = "parsed function definition.\n";
+    for (int i = 0; i < 300; i++) {
+        source += "exec sq(" + std::to_string(i) + ")";
+        expected += std::to_string(i * i) + "\n";
+        if (i == 150) {
+            source += "def cube(x: i32) -> i32 {return x * sq(x);}";
+            expected += "parsed function definition.\n";
+        }
+    }
+
+    std::string stats = "";
+    llvm::raw_string_ostream stats_output(stats);
+    codegen_helper({source, "exec cube(3)"}, {expected, "27\n"},
+                   CodeGeneratorSetting {.print_ir = false, .exec_mode = ExecMode::Jit},
+                   [&](JitCodeGenerator& generator, size_t i) {
+                       if (i == 1) {
+                           generator.print_exec_stats(stats_output);
+                       }
+                   });
+    ASSERT_EQ(stats.find("301 execs, latest 301 in microseconds: p50 "), 0);
+
+    // with fewer than 100 samples p99 is the slowest of them
+    stats.clear();
+    codegen_helper({"def sq(x: i32) -> i32 {return x * x;}\nexec sq(1)\nexec sq(2)\nexec sq(3)\n"},
+                   {"parsed function definition.\n1\n4\n9\n"},
+                   CodeGeneratorSetting {.print_ir = false, .batch_execs = false},
+                   [&](JitCodeGenerator& generator, size_t) { generator.print_exec_stats(stats_output); });
+    auto p99 = stats.find(", p99 ");
+    auto max = stats.find(", max ");
+    ASSERT_NE(p99, std::string::npos);
+    ASSERT_NE(max, std::string::npos);
+    ASSERT_EQ(stats.substr(p99 + 6, max - p99 - 6), stats.substr(max + 6, stats.find('\n') - max - 6));
+}
+
+TEST(CODEGEN, batchedExecs) {
+    // the execs between two other items share one module, unless only some of them loop, the output is
+    // the same either way
+    std::vector<std::string> target = {
+        "def f(x: i32) -> i32 {return x + 1;}\n"
+        "exec f(1) exec: double 2.5 exec: bool 1 < 2 exec f(f(3))\n"
+        "exec: double for (i = 0: i32, i < 3) {f(i);} exec f(4)\n"
+        "extern sin(x: double) -> double\n"
+        "exec: double sin(0.0)\n"
+        "struct Foo {a: double, b: double,}\n"
+        "exec f(0)\n"
+        "def g(x: i32) -> i32 {return f(x) + 10;}\n"
+        "exec g(1)\n",
+    };
+
+    std::vector<std::string> answer = {
+        "parsed function definition.\n"
+        "2\n" "2.500000\n" "true\n" "5\n"
+        "0.000000\n" "5\n"
+        "declare double @sin(double)\n"
+        "0.000000\n"
+        "parsed struct definition.\n"
+        "1\n"
+        "parsed function definition.\n"
+        "12\n",
+    };
+
+    codegen_helper(target, answer,
+                   CodeGeneratorSetting {.print_ir = false, .batch_execs = true, .exec_mode = ExecMode::Jit});
+    codegen_helper(target, answer,
+                   CodeGeneratorSetting {.print_ir = false, .batch_execs = false, .exec_mode = ExecMode::Jit});
+    codegen_helper(target, answer, CodeGeneratorSetting {.print_ir = false, .exec_mode = ExecMode::Interpret});
+}
+
+TEST(CODEGEN, execCache) {
+    // a hit keeps its module past the release of the batch it was compiled in
+    std::string source;
+    std::string expected;
+    for (int i = 0; i < 300; i++) {
+        source += "exec f(3)\n";
+        expected += "4\n";
+    }
+    std::vector<std::string> target = {
+        "def f(x: i32) -> i32 {return x + 1;}\n"
+        "exec f(1) exec f(2)\n",
+        // hits in one batch with a miss which evicts the least recently run
+        "exec f(1) exec f(2) exec f(3) exec f(1)\n",
+        source,
+    };
+
+    std::vector<std::string> answer = {
+        "parsed function definition.\n2\n3\n",
+        "2\n3\n4\n2\n",
+        expected,
+    };
+
+    std::string stats = "";
+    llvm::raw_string_ostream stats_output(stats);
+    codegen_helper(target, answer,
+                   CodeGeneratorSetting {.print_ir = false, .exec_cache_size = 2, .exec_mode = ExecMode::Jit},
+                   [&](JitCodeGenerator& generator, size_t i) {
+                       if (i == 2) {
+                           generator.print_exec_stats(stats_output);
+                       }
+                   });
+    ASSERT_NE(stats.find("exec cache: 303 hits, 3 misses, 2 of 2 kept\n"), std::string::npos);
+}
+
+TEST(CODEGEN, interpreter) {
+    // the interpreter gives what the compiled exec gives, calls go to the jitted functions
+    std::vector<std::string> target = {
+        "def sq(x: i32) -> i32 {return x * x;}\n"
+        "def unary ! (v: double) -> double {if (bool(v)) {return 0;} else {return 1;}}\n"
+        "extern sin(x: double) -> double\n",
+        "exec sq(3) + sq(4)\n"
+        "exec: i32 2147483647 + 1\n"
+        "exec: double !0 + sin(0.0)\n"
+        "exec: bool sq(2) < 5\n"
+        "exec: double 0.5 - 1\n"
+        "exec: i32 i32(0 - 2.7)\n"
+        "exec: double for (i = 0: i32, i < 3) {sq(i);}\n",
+    };
+
+    std::vector<std::string> answer = {
+        "parsed function definition.\n"
+        "parsed function definition.\n"
+        "declare double @sin(double)\n",
+        "25\n" "-2147483648\n" "1.000000\n" "true\n" "-0.500000\n" "-2\n" "0.000000\n",
+    };
+
+    codegen_helper(target, answer, CodeGeneratorSetting {.print_ir = false, .exec_mode = ExecMode::Jit});
+    codegen_helper(target, answer, CodeGeneratorSetting {.print_ir = false, .exec_mode = ExecMode::Interpret});
+
+    // the loop is left to the jit
+    std::string stats = "";
+    llvm::raw_string_ostream stats_output(stats);
+    codegen_helper(target, answer, CodeGeneratorSetting {.print_ir = false},
+                   [&](JitCodeGenerator& generator, size_t i) {
+                       if (i == 1) {
+                           generator.print_exec_stats(stats_output);
+                       }
+                   });
+    ASSERT_NE(stats.find("interpreted 6 of 7 execs\n"), std::string::npos);
+}
+
 TEST(CODEGEN, addInt) {
     std::vector<std::string> target = {
         "def myadd(n: i32) -> i32 {return n+1;}",
@@ -414,3 +695,130 @@ TEST(CODEGEN, structNested) {
     assert(target.size() == answer.size());
     codegen_helper(target, answer);
 }
+
+TEST(CODEGEN, recompileFunction) {
+    std::string first_ir = "";
+    llvm::raw_string_ostream first_output(first_ir);
+    CodeGenerator first(first_output, CodeGeneratorSetting {.print_ir = true});
+    {
+        TypeChecker checker(first.type_manager_);
+        auto parser = Parser(Lexer("def f(x: double) -> double { return x * x + 1; }"),
+                             first.binary_oper_precedence_);
+        auto asts = parser.parse();
+        ASSERT_EQ(asts.size(), 1);
+        ASSERT_TRUE(checker.check(*asts[0]));
+        first.codegen(std::move(asts));
+    }
+
+    // the parser is gone, the definition must still be there to lower again
+    auto node = first.find_function_node(Symbol("f"));
+    ASSERT_NE(node, nullptr);
+
+    std::string second_ir = "";
+    llvm::raw_string_ostream second_output(second_ir);
+    CodeGenerator second(second_output, CodeGeneratorSetting {.print_ir = false});
+    auto function = second.codegen(*node);
+    ASSERT_NE(function, nullptr);
+    function->print(second_output);
+    ASSERT_EQ(first_ir, second_ir);
+}
+
+TEST(CODEGEN, checkerAnnotations) {
+    TypeManager manager;
+    TypeChecker checker(manager);
+    std::unordered_map<Symbol, int> precedence = {{Symbols::assign, 2}, {Symbol("+"), 20}};
+
+    auto parser = Parser(Lexer("struct Foo {m: double, n: i32,}"
+                               "def f() -> i32 {var x: Foo; x.n = 3; return x.n + 1;}"), precedence);
+    auto asts = parser.parse();
+    ASSERT_EQ(asts.size(), 2);
+    auto& s = std::get<StructNode>(asts[0]->data);
+    manager.add_type(s.name, s.elements);
+    ASSERT_TRUE(checker.check(*asts[1]));
+
+    auto& body = std::get<FunctionNode>(asts[1]->data).body.data;
+    ASSERT_EQ(expr_cast<VarDeclareExpr>(body[0])->type_id, manager.find_type_by_name(Symbol("Foo"))->id);
+
+    auto assign = expr_cast<BinaryExpr>(body[1]);
+    auto member = expr_cast<VariableExpr>(assign->lhs);
+    ASSERT_EQ(std::get<VariableExpr::Field>(member->addrs[0]).index, 1);
+    ASSERT_EQ(expr_cast<LiteralExpr>(assign->rhs)->type_id, TypeSystem::BuiltinTypes::i32);
+
+    auto sum = expr_cast<BinaryExpr>(expr_cast<ReturnExpr>(body[2])->ret);
+    ASSERT_EQ(expr_cast<LiteralExpr>(sum->rhs)->type_id, TypeSystem::BuiltinTypes::i32);
+}
+
+TEST(CODEGEN, optLevels) {
+    ASSERT_EQ(parse_opt_level("-O3"), OptLevel::O3);
+    ASSERT_EQ(parse_opt_level("s"), OptLevel::Os);
+    ASSERT_EQ(parse_opt_level("O4"), std::nullopt);
+
+    std::vector<std::string> target = {
+        "def sum(n: double) -> double {var a: double = 0; var b: double = 0;"
+        "for (i = 0: double, i < n) {b = a + b; a = a + 1;} return b; }"
+        "exec sum(100)",
+    };
+    std::vector<std::string> answer = {"parsed function definition.\n5050.000000\n"};
+
+    for (auto level: {OptLevel::O0, OptLevel::O1, OptLevel::O2, OptLevel::O3, OptLevel::Os, OptLevel::Oz}) {
+        codegen_helper(target, answer, CodeGeneratorSetting {
+            .print_ir = false,
+            .function_pass_optimize = true,
+            .opt_level = level,
+        });
+    }
+}
+
+TEST(CODEGEN, targetSelection) {
+    auto native = resolve_target(TargetSelection {.cpu = "native", .features = "-avx512f"});
+    ASSERT_FALSE(native.cpu.empty());
+    ASSERT_NE(native.cpu, "native");
+    ASSERT_TRUE(native.features.ends_with("-avx512f"));
+
+    auto explicit_cpu = resolve_target(TargetSelection {.cpu = "generic", .features = ""});
+    ASSERT_EQ(explicit_cpu.cpu, "generic");
+
+    codegen_helper({"exec: double 2 + 3"}, {"5.000000\n"}, CodeGeneratorSetting {
+        .print_ir = false,
+        .target = explicit_cpu,
+    });
+}
+
+TEST(CODEGEN, tieredCompile) {
+    std::vector<std::string> target = {
+        "def fibo(n: i32) -> i32 {if (n < 2) {return n;} else {return fibo(n - 1) + fibo(n - 2);}}",
+        "def once(n: i32) -> i32 {return fibo(n) + 1;}",
+        "exec fibo(5)",
+        // past the threshold fibo moves up, its callers keep working across the switch
+        "exec once(15)",
+        "exec once(20)",
+    };
+
+    std::vector<std::string> answer = {
+        "parsed function definition.\n",
+        "parsed function definition.\n",
+        "5\n",
+        "611\n",
+        "6766\n",
+    };
+
+    std::string stats = "";
+    llvm::raw_string_ostream stats_output(stats);
+    codegen_helper(target, answer, CodeGeneratorSetting {
+        .print_ir = false,
+        .tiered_compile = true,
+        .hot_call_threshold = 50,
+    }, [&](JitCodeGenerator& generator, size_t i) {
+        if (i == 2) {
+            generator.print_tier_stats(stats_output);
+            EXPECT_NE(stats.find("fibo: tier 0, 15 calls"), std::string::npos);
+        } else if (i == 3) {
+            generator.wait_for_tier_up();
+        } else if (i == 4) {
+            stats.clear();
+            generator.print_tier_stats(stats_output);
+            EXPECT_NE(stats.find("fibo: tier 1"), std::string::npos);
+            EXPECT_NE(stats.find("once: tier 0, 2 calls"), std::string::npos);
+        }
+    });
+}
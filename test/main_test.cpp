@@ -2,6 +2,7 @@
 #include "ast/lexer_test.hpp"
 #include "ast/parser_test.hpp"
 #include "codegen/codegen_test.hpp"
+#include <llvm-c/Target.h>
 
 int main() {
     LLVMInitializeNativeTarget();